@@ -0,0 +1,139 @@
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Writes all of [data, data + size) to fd, retrying short writes
+inline bool WriteFully(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Flushes a rename or unlink in the directory holding fileName to disk
+inline bool SyncDirectoryOf(const std::string& fileName)
+{
+    size_t slash = fileName.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : fileName.substr(0, slash));
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+// Writes a file aside as <fileName>.tmp and renames it over fileName once it
+// is on disk, so readers and crashes see either the old file or the whole
+// new one. A writer destroyed without Commit() removes its temp file.
+class AtomicFileWriter
+{
+    public:
+        static const size_t BUFFER_SIZE = 1 << 20;
+
+        explicit AtomicFileWriter(const std::string& fileName) : fileName_(fileName), tempName_(fileName + ".tmp"), fd_(-1), failed_(false)
+        {
+            fd_ = open(tempName_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            failed_ = fd_ < 0;
+            buffer_.reserve(BUFFER_SIZE);
+        }
+
+        AtomicFileWriter(const AtomicFileWriter&) = delete;
+        AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+        ~AtomicFileWriter()
+        {
+            if (fd_ >= 0)
+            {
+                close(fd_);
+                std::remove(tempName_.c_str());
+            }
+        }
+
+        bool IsOk() const
+        {
+            return !failed_;
+        }
+
+        void Write(const char* data, size_t size)
+        {
+            if (failed_)
+            {
+                return;
+            }
+
+            if (buffer_.size() + size > BUFFER_SIZE)
+            {
+                Flush();
+                if (size > BUFFER_SIZE)
+                {
+                    failed_ = failed_ || !WriteFully(fd_, data, size);
+                    return;
+                }
+            }
+            buffer_.append(data, size);
+        }
+
+        void Write(std::string_view text)
+        {
+            Write(text.data(), text.size());
+        }
+
+        // Syncs the data, renames it over the target and syncs the directory
+        bool Commit()
+        {
+            Flush();
+            if (failed_ || fsync(fd_) != 0)
+            {
+                return false;
+            }
+
+            bool closed = close(fd_) == 0;
+            fd_ = -1;
+            if (!closed || std::rename(tempName_.c_str(), fileName_.c_str()) != 0)
+            {
+                std::remove(tempName_.c_str());
+                return false;
+            }
+            SyncDirectoryOf(fileName_);
+            return true;
+        }
+
+    private:
+        std::string fileName_;
+        std::string tempName_;
+        std::string buffer_;
+        int fd_;
+        bool failed_;
+
+        void Flush()
+        {
+            if (!failed_ && !buffer_.empty())
+            {
+                failed_ = !WriteFully(fd_, buffer_.data(), buffer_.size());
+            }
+            buffer_.clear();
+        }
+};
+
+#endif // ATOMICFILE_H
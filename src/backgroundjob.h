@@ -0,0 +1,51 @@
+#ifndef BACKGROUNDJOB_H
+#define BACKGROUNDJOB_H
+
+#include <wx/thread.h>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Progress a job publishes for the GUI thread to poll, and the flag the GUI
+// thread sets to cancel it. Units are whatever the job counts, bytes or rows.
+struct JobProgress
+{
+    std::atomic<std::uint64_t> done{0};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<bool> cancelled{false};
+
+    bool IsCancelled() const
+    {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+};
+
+// Runs one function on a joinable thread; the owner polls IsFinished() and
+// then calls Wait()
+class BackgroundJob : public wxThread
+{
+    public:
+        explicit BackgroundJob(std::function<void()> work) : wxThread(wxTHREAD_JOINABLE), work_(std::move(work)), finished_(false)
+        {
+
+        }
+
+        bool IsFinished() const
+        {
+            return finished_.load(std::memory_order_acquire);
+        }
+
+    protected:
+        ExitCode Entry() override
+        {
+            work_();
+            finished_.store(true, std::memory_order_release);
+            return static_cast<ExitCode>(0);
+        }
+
+    private:
+        std::function<void()> work_;
+        std::atomic<bool> finished_;
+};
+
+#endif // BACKGROUNDJOB_H
@@ -0,0 +1,247 @@
+#ifndef COMPANYTABLE_H
+#define COMPANYTABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+class ContactNode;
+
+// Reads a RIF written as "J-12345678-9", "j123456789" or with spaces and
+// writes it as "J-12345678-9". Returns false unless it has a V, E, J, P, G
+// or C prefix, nine digits and a matching check digit.
+inline bool NormalizeRif(std::string_view text, std::string& rif)
+{
+    static const int WEIGHTS[9] = {4, 3, 2, 7, 6, 5, 4, 3, 2};
+
+    size_t position = 0;
+    while (position < text.size() && text[position] == ' ')
+    {
+        position++;
+    }
+    if (position == text.size())
+    {
+        return false;
+    }
+
+    int prefixValue;
+    char prefix = text[position++];
+    if (prefix >= 'a' && prefix <= 'z')
+    {
+        prefix = static_cast<char>(prefix - 'a' + 'A');
+    }
+    switch (prefix)
+    {
+        case 'V':
+            prefixValue = 1;
+            break;
+        case 'E':
+            prefixValue = 2;
+            break;
+        case 'J':
+        case 'C':
+            prefixValue = 3;
+            break;
+        case 'P':
+            prefixValue = 4;
+            break;
+        case 'G':
+            prefixValue = 5;
+            break;
+        default:
+            return false;
+    }
+
+    char digits[9];
+    size_t count = 0;
+    for (; position < text.size(); position++)
+    {
+        char c = text[position];
+        if (c >= '0' && c <= '9')
+        {
+            if (count == 9)
+            {
+                return false;
+            }
+            digits[count++] = c;
+        }
+        else if (c != '-' && c != ' ' && c != '.')
+        {
+            return false;
+        }
+    }
+    if (count != 9)
+    {
+        return false;
+    }
+
+    int sum = prefixValue * WEIGHTS[0];
+    for (int i = 0; i < 8; i++)
+    {
+        sum += (digits[i] - '0') * WEIGHTS[i + 1];
+    }
+    int check = 11 - sum % 11;
+    if (check > 9)
+    {
+        check = 0;
+    }
+    if (digits[8] - '0' != check)
+    {
+        return false;
+    }
+
+    rif.assign(1, prefix);
+    rif += '-';
+    rif.append(digits, 8);
+    rif += '-';
+    rif += digits[8];
+    return true;
+}
+
+// A company shared by the contacts that work at it
+struct Company
+{
+    std::string rif;
+    std::string name;
+    std::string phone;
+
+    // Stored contacts at the company, in no particular order
+    std::vector<ContactNode*> contacts;
+};
+
+// Companies keyed by normalized RIF. Contacts hold the small id of their
+// company instead of copies of its name, phone and RIF, so editing a
+// company is one change however many contacts it has, and its contacts are
+// listed without scanning the agenda. Ids start at 1; 0 means no company.
+// Remembers the company each contact is listed under, so a contact can be
+// moved after its company id was edited.
+class CompanyTable
+{
+    public:
+        static const std::uint32_t NO_COMPANY = 0;
+
+        void Clear()
+        {
+            companies_.clear();
+            idsByRif_.clear();
+            membership_.clear();
+        }
+
+        // Id of the company with this normalized RIF, created if it is new.
+        // The name and phone of a known company are only filled in if empty,
+        // so the first spelling read wins.
+        std::uint32_t Intern(const std::string& rif, std::string_view name, std::string_view phone)
+        {
+            auto inserted = idsByRif_.emplace(rif, static_cast<std::uint32_t>(companies_.size() + 1));
+            if (inserted.second)
+            {
+                companies_.push_back(Company{rif, std::string(name), std::string(phone), std::vector<ContactNode*>()});
+                return inserted.first->second;
+            }
+
+            Company& company = companies_[inserted.first->second - 1];
+            if (company.name.empty())
+            {
+                company.name.assign(name.data(), name.size());
+            }
+            if (company.phone.empty())
+            {
+                company.phone.assign(phone.data(), phone.size());
+            }
+            return inserted.first->second;
+        }
+
+        // Replaces the name and phone of a company with the non-empty values
+        // given; returns true if either changed
+        bool Update(std::uint32_t id, std::string_view name, std::string_view phone)
+        {
+            Company& company = companies_[id - 1];
+            bool changed = false;
+            if (!name.empty() && name != company.name)
+            {
+                company.name.assign(name.data(), name.size());
+                changed = true;
+            }
+            if (!phone.empty() && phone != company.phone)
+            {
+                company.phone.assign(phone.data(), phone.size());
+                changed = true;
+            }
+            return changed;
+        }
+
+        // Id of the company with this RIF, written in any accepted form, or NO_COMPANY
+        std::uint32_t Find(std::string_view rifText) const
+        {
+            std::string rif;
+            if (!NormalizeRif(rifText, rif))
+            {
+                return NO_COMPANY;
+            }
+            auto it = idsByRif_.find(rif);
+            return it == idsByRif_.end() ? NO_COMPANY : it->second;
+        }
+
+        const Company& Get(std::uint32_t id) const
+        {
+            return companies_[id - 1];
+        }
+
+        // Lists the contact under the given company only, or under none for NO_COMPANY
+        void SetMember(ContactNode* contact, std::uint32_t id)
+        {
+            auto listed = membership_.find(contact);
+            std::uint32_t current = listed == membership_.end() ? NO_COMPANY : listed->second;
+            if (current == id)
+            {
+                return;
+            }
+
+            if (current != NO_COMPANY)
+            {
+                std::vector<ContactNode*>& contacts = companies_[current - 1].contacts;
+                for (size_t i = 0; i < contacts.size(); i++)
+                {
+                    if (contacts[i] == contact)
+                    {
+                        contacts[i] = contacts.back();
+                        contacts.pop_back();
+                        break;
+                    }
+                }
+            }
+            if (id == NO_COMPANY)
+            {
+                membership_.erase(listed);
+                return;
+            }
+            companies_[id - 1].contacts.push_back(contact);
+            membership_[contact] = id;
+        }
+
+        // Empties every contact list, keeping the companies for contacts not stored yet
+        void ClearMembers()
+        {
+            for (Company& company : companies_)
+            {
+                company.contacts.clear();
+            }
+            membership_.clear();
+        }
+
+        size_t Size() const
+        {
+            return companies_.size();
+        }
+
+    private:
+        // A deque keeps companies in place as it grows, ids index it
+        std::deque<Company> companies_;
+        std::unordered_map<std::string, std::uint32_t> idsByRif_;
+        std::unordered_map<const ContactNode*, std::uint32_t> membership_;
+};
+
+#endif // COMPANYTABLE_H
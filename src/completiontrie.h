@@ -0,0 +1,327 @@
+#ifndef COMPLETIONTRIE_H
+#define COMPLETIONTRIE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include "contactnode.h"
+#include "contactstore.h"
+#include "textfold.h"
+
+// Radix trie of the values of one field, keyed by their folded text and
+// counting how many contacts use each. Every node also knows the largest
+// count below it, so the most used completions of a prefix come out of a
+// best-first walk that only visits the branches able to hold them.
+class CompletionTrie
+{
+    public:
+        void Clear()
+        {
+            root_ = Node();
+        }
+
+        // Counts one more use of value; the first spelling seen is the one completed
+        void Insert(std::string_view value)
+        {
+            std::string key = FoldText(value);
+            if (key.empty())
+            {
+                return;
+            }
+
+            std::vector<Node*> path(1, &root_);
+            size_t matched = 0;
+            while (matched < key.size())
+            {
+                Node* node = path.back();
+                size_t slot = FindChild(*node, key[matched]);
+                if (slot == node->children.size() || node->children[slot]->label[0] != key[matched])
+                {
+                    std::unique_ptr<Node> leaf(new Node());
+                    leaf->label = key.substr(matched);
+                    path.push_back(leaf.get());
+                    node->children.insert(node->children.begin() + slot, std::move(leaf));
+                    break;
+                }
+
+                // Split the edge where the key leaves it
+                std::unique_ptr<Node>& child = node->children[slot];
+                size_t common = CommonPrefix(child->label, std::string_view(key).substr(matched));
+                if (common < child->label.size())
+                {
+                    std::unique_ptr<Node> middle(new Node());
+                    middle->label = child->label.substr(0, common);
+                    middle->maxCount = child->maxCount;
+                    child->label.erase(0, common);
+                    middle->children.push_back(std::move(child));
+                    child = std::move(middle);
+                }
+                path.push_back(child.get());
+                matched += common;
+            }
+
+            Node* end = path.back();
+            if (end->count++ == 0)
+            {
+                end->value.assign(value.data(), value.size());
+            }
+            for (Node* node : path)
+            {
+                node->maxCount = std::max(node->maxCount, end->count);
+            }
+        }
+
+        // Counts one use of value less, pruning the nodes nothing uses anymore
+        void Remove(std::string_view value)
+        {
+            std::string key = FoldText(value);
+            if (key.empty())
+            {
+                return;
+            }
+
+            std::vector<Node*> path(1, &root_);
+            size_t matched = 0;
+            while (matched < key.size())
+            {
+                Node* node = path.back();
+                size_t slot = FindChild(*node, key[matched]);
+                if (slot == node->children.size() || std::string_view(key).substr(matched, node->children[slot]->label.size()) != node->children[slot]->label)
+                {
+                    return;
+                }
+                matched += node->children[slot]->label.size();
+                path.push_back(node->children[slot].get());
+            }
+
+            Node* end = path.back();
+            if (end->count == 0)
+            {
+                return;
+            }
+            if (--end->count == 0)
+            {
+                std::string().swap(end->value);
+            }
+
+            for (size_t depth = path.size() - 1; depth > 0; depth--)
+            {
+                Node* node = path[depth];
+                Node* parent = path[depth - 1];
+                if (node->count == 0 && node->children.empty())
+                {
+                    parent->children.erase(parent->children.begin() + FindChild(*parent, node->label[0]));
+                }
+                else if (node->count == 0 && node->children.size() == 1)
+                {
+                    // A pass-through node merges into its only child
+                    std::unique_ptr<Node> child = std::move(node->children[0]);
+                    child->label.insert(0, node->label);
+                    parent->children[FindChild(*parent, node->label[0])] = std::move(child);
+                }
+                else
+                {
+                    UpdateMaxCount(*node);
+                }
+            }
+            UpdateMaxCount(root_);
+        }
+
+        // Appends up to limit values starting with prefix, ignoring case and
+        // accents, most used first
+        void Complete(std::string_view prefix, size_t limit, std::vector<std::string>& completions) const
+        {
+            std::string key = FoldText(prefix);
+            const Node* node = &root_;
+            size_t matched = 0;
+            while (matched < key.size())
+            {
+                size_t slot = FindChild(*node, key[matched]);
+                if (slot == node->children.size() || node->children[slot]->label[0] != key[matched])
+                {
+                    return;
+                }
+                const Node* child = node->children[slot].get();
+                size_t common = CommonPrefix(child->label, std::string_view(key).substr(matched));
+                if (common < child->label.size() && matched + common < key.size())
+                {
+                    return;
+                }
+                matched += common;
+                node = child;
+            }
+
+            // A node is queued with the best count below it, a value with its own count
+            struct Entry
+            {
+                std::uint32_t count;
+                const Node* node;
+                bool isValue;
+
+                bool operator<(const Entry& other) const
+                {
+                    return count < other.count || (count == other.count && isValue < other.isValue);
+                }
+            };
+            std::priority_queue<Entry> frontier;
+            frontier.push(Entry{node->maxCount, node, false});
+            size_t found = 0;
+            while (!frontier.empty() && found < limit)
+            {
+                Entry entry = frontier.top();
+                frontier.pop();
+                if (entry.isValue)
+                {
+                    completions.push_back(entry.node->value);
+                    found++;
+                    continue;
+                }
+                if (entry.node->count > 0)
+                {
+                    frontier.push(Entry{entry.node->count, entry.node, true});
+                }
+                for (const std::unique_ptr<Node>& child : entry.node->children)
+                {
+                    frontier.push(Entry{child->maxCount, child.get(), false});
+                }
+            }
+        }
+
+    private:
+        struct Node
+        {
+            // Bytes of the edge from the parent, never empty below the root
+            std::string label;
+            std::string value;
+            std::uint32_t count = 0;
+            std::uint32_t maxCount = 0;
+
+            // Sorted by the first byte of their label
+            std::vector<std::unique_ptr<Node>> children;
+        };
+
+        Node root_;
+
+        // Slot of the child whose label starts with c, or where it would go
+        static size_t FindChild(const Node& node, char c)
+        {
+            auto it = std::lower_bound(node.children.begin(), node.children.end(), c, [](const std::unique_ptr<Node>& child, char value)
+            {
+                return static_cast<unsigned char>(child->label[0]) < static_cast<unsigned char>(value);
+            });
+            return it - node.children.begin();
+        }
+
+        static size_t CommonPrefix(std::string_view a, std::string_view b)
+        {
+            size_t length = 0;
+            while (length < a.size() && length < b.size() && a[length] == b[length])
+            {
+                length++;
+            }
+            return length;
+        }
+
+        static void UpdateMaxCount(Node& node)
+        {
+            node.maxCount = node.count;
+            for (const std::unique_ptr<Node>& child : node.children)
+            {
+                node.maxCount = std::max(node.maxCount, child->maxCount);
+            }
+        }
+};
+
+// Completion tries of the first name, last name, company and address of the
+// stored contacts. After the whole agenda is replaced they are only rebuilt
+// once a completion is asked for.
+class ContactCompletions
+{
+    public:
+        // Completions offered at most
+        static const size_t MAX_COMPLETIONS = 10;
+
+        explicit ContactCompletions(const ContactStore& store) : store_(store), stale_(true)
+        {
+
+        }
+
+        void MarkStale()
+        {
+            stale_ = true;
+            for (CompletionTrie& trie : tries_)
+            {
+                trie.Clear();
+            }
+        }
+
+        void AddContact(const ContactNode* contact)
+        {
+            if (stale_)
+            {
+                return;
+            }
+            for (size_t i = 0; i < FIELD_TRIES; i++)
+            {
+                tries_[i].Insert(contact->getField(COMPLETED_FIELDS[i]));
+            }
+        }
+
+        // Called before a contact is edited or deleted
+        void RemoveContact(const ContactNode* contact)
+        {
+            if (stale_)
+            {
+                return;
+            }
+            for (size_t i = 0; i < FIELD_TRIES; i++)
+            {
+                tries_[i].Remove(contact->getField(COMPLETED_FIELDS[i]));
+            }
+        }
+
+        // Called for each stored contact of a company whose name changed
+        void CompanyRenamed(std::string_view oldName, std::string_view newName)
+        {
+            if (stale_ || oldName == newName)
+            {
+                return;
+            }
+            tries_[COMPANY_NAME_TRIE].Remove(oldName);
+            tries_[COMPANY_NAME_TRIE].Insert(newName);
+        }
+
+        void Complete(ContactField field, std::string_view prefix, std::vector<std::string>& completions)
+        {
+            if (stale_)
+            {
+                stale_ = false;
+                for (const ContactNode* contact : store_.GetContacts())
+                {
+                    AddContact(contact);
+                }
+            }
+            for (size_t i = 0; i < FIELD_TRIES; i++)
+            {
+                if (COMPLETED_FIELDS[i] == field)
+                {
+                    tries_[i].Complete(prefix, MAX_COMPLETIONS, completions);
+                }
+            }
+        }
+
+    private:
+        static const size_t FIELD_TRIES = 4;
+        static constexpr ContactField COMPLETED_FIELDS[FIELD_TRIES] = {FIELD_FIRST_NAME, FIELD_LAST_NAME, FIELD_COMPANY_NAME, FIELD_ADDRESS};
+        static const size_t COMPANY_NAME_TRIE = 2;
+
+        const ContactStore& store_;
+        CompletionTrie tries_[FIELD_TRIES];
+        bool stale_;
+};
+
+#endif // COMPLETIONTRIE_H
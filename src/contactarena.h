@@ -0,0 +1,126 @@
+#ifndef CONTACTARENA_H
+#define CONTACTARENA_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "contactsnapshot.h"
+#include "companytable.h"
+
+// Append-only byte storage for the fields of every contact of a store.
+// Each contact keeps its eight fields back to back in one allocation, so a
+// contact costs one small record plus its text instead of eight strings.
+// Chunks never move, so field bytes stay put until the store compacts the
+// arena. Replaced bytes are only counted as garbage; the store copies the
+// live contacts into fresh chunks once garbage outweighs them.
+// The companies the contacts share live here too, in one table per store.
+class ContactArena
+{
+    public:
+        // Size of a regular chunk, larger records get a chunk of their own
+        static const size_t CHUNK_SIZE = 1 << 20;
+
+        ContactArena() : chunkUsed_(CHUNK_SIZE), usedBytes_(0), garbageBytes_(0)
+        {
+
+        }
+
+        ContactArena(const ContactArena&) = delete;
+        ContactArena& operator=(const ContactArena&) = delete;
+
+        // Returns room for size contiguous bytes
+        char* Allocate(size_t size)
+        {
+            if (size == 0)
+            {
+                return nullptr;
+            }
+            usedBytes_ += size;
+
+            if (size > CHUNK_SIZE / 4)
+            {
+                // Kept in front of the chunk being filled, which stays last
+                std::unique_ptr<char[]> chunk(new char[size]);
+                char* data = chunk.get();
+                chunks_.insert(chunks_.empty() ? chunks_.end() : chunks_.end() - 1, std::move(chunk));
+                return data;
+            }
+
+            if (chunkUsed_ + size > CHUNK_SIZE)
+            {
+                chunks_.emplace_back(new char[CHUNK_SIZE]);
+                chunkUsed_ = 0;
+            }
+            char* data = chunks_.back().get() + chunkUsed_;
+            chunkUsed_ += size;
+            return data;
+        }
+
+        // Marks bytes handed out by Allocate() as no longer used
+        void Release(size_t size)
+        {
+            garbageBytes_ += size;
+        }
+
+        // Keeps a mapped snapshot alive while contacts read from it
+        void AdoptSnapshot(const std::shared_ptr<const ContactSnapshot>& snapshot)
+        {
+            snapshots_.push_back(snapshot);
+        }
+
+        // Hands over every chunk and starts empty; the caller copies the live
+        // contacts back in before dropping the old chunks
+        std::vector<std::unique_ptr<char[]>> DetachChunks()
+        {
+            std::vector<std::unique_ptr<char[]>> chunks;
+            chunks.swap(chunks_);
+            chunkUsed_ = CHUNK_SIZE;
+            usedBytes_ = 0;
+            garbageBytes_ = 0;
+            return chunks;
+        }
+
+        // Keeps a buffer of field bytes that contacts read in place alive
+        void AdoptBuffer(std::unique_ptr<char[]> buffer)
+        {
+            buffers_.push_back(std::move(buffer));
+        }
+
+        // Drops every adopted snapshot and buffer
+        void ReleaseAdopted()
+        {
+            snapshots_.clear();
+            buffers_.clear();
+        }
+
+        size_t GetLiveBytes() const
+        {
+            return usedBytes_ - garbageBytes_;
+        }
+
+        size_t GetGarbageBytes() const
+        {
+            return garbageBytes_;
+        }
+
+        CompanyTable& GetCompanies()
+        {
+            return companies_;
+        }
+
+        const CompanyTable& GetCompanies() const
+        {
+            return companies_;
+        }
+
+    private:
+        std::vector<std::unique_ptr<char[]>> chunks_;
+        std::vector<std::shared_ptr<const ContactSnapshot>> snapshots_;
+        std::vector<std::unique_ptr<char[]>> buffers_;
+        CompanyTable companies_;
+        size_t chunkUsed_;
+        size_t usedBytes_;
+        size_t garbageBytes_;
+};
+
+#endif // CONTACTARENA_H
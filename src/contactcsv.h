@@ -0,0 +1,285 @@
+#ifndef CONTACTCSV_H
+#define CONTACTCSV_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include "atomicfile.h"
+#include "backgroundjob.h"
+#include "delimiterscanner.h"
+#include "contactnode.h"
+
+// Writes one CSV field, quoted as RFC 4180 asks when it holds a comma, a
+// quote or a line break; quotes inside it are doubled
+inline void WriteCsvField(AtomicFileWriter& output, std::string_view field)
+{
+    if (field.find_first_of(",\"\r\n") == std::string_view::npos)
+    {
+        output.Write(field);
+        return;
+    }
+
+    output.Write("\"", 1);
+    size_t start = 0;
+    size_t quote;
+    while ((quote = field.find('"', start)) != std::string_view::npos)
+    {
+        output.Write(field.substr(start, quote + 1 - start));
+        output.Write("\"", 1);
+        start = quote + 1;
+    }
+    output.Write(field.substr(start));
+    output.Write("\"", 1);
+}
+
+// Writes the contacts to fileName as CSV, one CRLF terminated record of the
+// eight fields per contact, in the given order. Fields are streamed straight
+// from the contacts through the writer's buffer, so memory use does not grow
+// with the export, and fileName is only replaced once the whole file is on disk.
+// If progress is given, rows written are published to it and a cancelled export
+// returns false leaving fileName as it was.
+inline bool ExportContactsCsv(const std::vector<ContactNode*>& contacts, const std::string& fileName, JobProgress* progress = nullptr)
+{
+    // Rows written between two progress updates and cancel checks
+    const size_t PROGRESS_STEP = 4096;
+
+    if (progress)
+    {
+        progress->total = contacts.size();
+    }
+
+    AtomicFileWriter output(fileName);
+    for (size_t row = 0; row < contacts.size(); row++)
+    {
+        if (progress && row % PROGRESS_STEP == 0)
+        {
+            if (progress->IsCancelled())
+            {
+                return false;
+            }
+            progress->done = row;
+        }
+
+        const ContactNode* contact = contacts[row];
+        WriteCsvField(output, contact->getFirstName());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getLastName());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getPhoneNumber());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getAddress());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getCompanyName());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getCompanyPhone());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getCompanyRif());
+        output.Write(",", 1);
+        WriteCsvField(output, contact->getNewEvent());
+        output.Write("\r\n", 2);
+    }
+
+    if (progress)
+    {
+        if (progress->IsCancelled())
+        {
+            return false;
+        }
+        progress->done = contacts.size();
+    }
+    return output.Commit();
+}
+
+// Reads RFC 4180 CSV records one at a time through a fixed size buffer, so
+// memory use depends on the longest record rather than on the file. Quoted
+// fields may hold commas, doubled quotes and line breaks. Outside quotes a
+// CR before the line end is dropped and stray quotes are kept as text.
+class CsvReader
+{
+    public:
+        static const size_t BUFFER_SIZE = 1 << 20;
+
+        explicit CsvReader(const std::string& fileName) : file_(fileName, std::ios::binary), buffer_(new char[BUFFER_SIZE]), position_(nullptr), end_(nullptr), scanner_(nullptr, nullptr, ','), bytesRead_(0), line_(1), recordLine_(1), malformed_(false)
+        {
+
+        }
+
+        bool IsOpen() const
+        {
+            return file_.is_open();
+        }
+
+        // Reads the next record into fields, skipping blank lines; returns false at the end of the file
+        bool ReadRecord(std::vector<std::string>& fields)
+        {
+            while (true)
+            {
+                fields.clear();
+                recordLine_ = line_;
+                malformed_ = false;
+                if (!ReadFields(fields))
+                {
+                    return false;
+                }
+                if (fields.size() > 1 || !fields[0].empty() || malformed_)
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Line the last record started on
+        size_t GetRecordLine() const
+        {
+            return recordLine_;
+        }
+
+        // True when the last record ended inside a quoted field
+        bool IsMalformed() const
+        {
+            return malformed_;
+        }
+
+        std::uint64_t GetBytesRead() const
+        {
+            return bytesRead_;
+        }
+
+    private:
+        std::ifstream file_;
+        std::unique_ptr<char[]> buffer_;
+        const char* position_;
+        const char* end_;
+        DelimiterScanner scanner_;
+        std::uint64_t bytesRead_;
+        size_t line_;
+        size_t recordLine_;
+        bool malformed_;
+
+        bool Refill()
+        {
+            if (!file_)
+            {
+                return false;
+            }
+            file_.read(buffer_.get(), BUFFER_SIZE);
+            std::streamsize count = file_.gcount();
+            if (count <= 0)
+            {
+                return false;
+            }
+            position_ = buffer_.get();
+            end_ = position_ + count;
+            scanner_ = DelimiterScanner(position_, end_, ',', '"', '\n');
+            bytesRead_ += static_cast<std::uint64_t>(count);
+            return true;
+        }
+
+        // Next delimiter at or after position_, skipping those a lookahead already consumed
+        const char* NextDelimiter()
+        {
+            const char* delimiter = scanner_.Next();
+            while (delimiter < position_)
+            {
+                delimiter = scanner_.Next();
+            }
+            return delimiter;
+        }
+
+        bool ReadFields(std::vector<std::string>& fields)
+        {
+            std::string field;
+            bool started = false;
+            bool quoted = false;
+            bool wasQuoted = false;
+            size_t quotedEnd = 0;
+
+            while (true)
+            {
+                if (position_ == end_ && !Refill())
+                {
+                    if (!started)
+                    {
+                        return false;
+                    }
+                    malformed_ = quoted;
+                    fields.push_back(std::move(field));
+                    return true;
+                }
+                started = true;
+
+                const char* delimiter = NextDelimiter();
+                field.append(position_, delimiter);
+                position_ = delimiter;
+                if (delimiter == end_)
+                {
+                    continue;
+                }
+                char c = *delimiter;
+                position_++;
+
+                if (c == '\n')
+                {
+                    line_++;
+                }
+
+                if (quoted)
+                {
+                    if (c != '"')
+                    {
+                        field += c;
+                        continue;
+                    }
+
+                    // A doubled quote is a literal one, a single quote closes the field
+                    if (position_ == end_)
+                    {
+                        Refill();
+                    }
+                    if (position_ < end_ && *position_ == '"')
+                    {
+                        field += '"';
+                        position_++;
+                    }
+                    else
+                    {
+                        quoted = false;
+                        quotedEnd = field.size();
+                    }
+                }
+                else if (c == '"')
+                {
+                    if (field.empty() && !wasQuoted)
+                    {
+                        quoted = true;
+                        wasQuoted = true;
+                    }
+                    else
+                    {
+                        field += c;
+                    }
+                }
+                else if (c == ',')
+                {
+                    fields.push_back(std::move(field));
+                    field.clear();
+                    wasQuoted = false;
+                    quotedEnd = 0;
+                }
+                else
+                {
+                    if (!field.empty() && field.back() == '\r' && (!wasQuoted || field.size() > quotedEnd))
+                    {
+                        field.pop_back();
+                    }
+                    fields.push_back(std::move(field));
+                    return true;
+                }
+            }
+        }
+};
+
+#endif // CONTACTCSV_H
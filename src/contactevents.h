@@ -0,0 +1,312 @@
+#ifndef CONTACTEVENTS_H
+#define CONTACTEVENTS_H
+
+#include <wx/datetime.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include "contactnode.h"
+
+// A dated event of a contact
+struct ContactEvent
+{
+    wxDateTime start;
+    std::string title;
+    std::string notes;
+};
+
+// Length of a start time written as YYYY-MM-DDTHH:MM
+const size_t EVENT_START_LENGTH = 16;
+
+// Appends text with the bytes that delimit records, fields and events
+// written as %XX, so an event never splits a contacts.txt line
+inline void AppendEventText(std::string& out, std::string_view text)
+{
+    for (char c : text)
+    {
+        if (c == '%' || c == ',' || c == ';' || c == '|' || c == '\n' || c == '\r')
+        {
+            char escaped[4];
+            std::snprintf(escaped, sizeof(escaped), "%%%02X", static_cast<unsigned char>(c));
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+inline int HexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// Undoes AppendEventText; returns false on a malformed escape
+inline bool ReadEventText(std::string_view text, std::string& out)
+{
+    out.clear();
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] != '%')
+        {
+            out += text[i];
+            continue;
+        }
+        int high = i + 2 < text.size() ? HexDigitValue(text[i + 1]) : -1;
+        int low = i + 2 < text.size() ? HexDigitValue(text[i + 2]) : -1;
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        out += static_cast<char>(high * 16 + low);
+        i += 2;
+    }
+    return true;
+}
+
+// Value of the digits in text[begin, begin + count), or -1
+inline int ReadEventNumber(std::string_view text, size_t begin, size_t count)
+{
+    int value = 0;
+    for (size_t i = begin; i < begin + count; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+        {
+            return -1;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return value;
+}
+
+// Reads a local start time written as YYYY-MM-DDTHH:MM
+inline bool ReadEventStart(std::string_view text, wxDateTime& start)
+{
+    if (text.size() != EVENT_START_LENGTH || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':')
+    {
+        return false;
+    }
+    int year = ReadEventNumber(text, 0, 4);
+    int month = ReadEventNumber(text, 5, 2);
+    int day = ReadEventNumber(text, 8, 2);
+    int hour = ReadEventNumber(text, 11, 2);
+    int minute = ReadEventNumber(text, 14, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > wxDateTime::GetNumberOfDays(static_cast<wxDateTime::Month>(month - 1), year) || hour < 0 || hour > 23 || minute < 0 || minute > 59)
+    {
+        return false;
+    }
+    start.Set(static_cast<wxDateTime::wxDateTime_t>(day), static_cast<wxDateTime::Month>(month - 1), year, static_cast<wxDateTime::wxDateTime_t>(hour), static_cast<wxDateTime::wxDateTime_t>(minute));
+    return start.IsValid();
+}
+
+// Writes events into the text of a contact's event field as
+// "start|title|notes" entries separated by ';'
+inline std::string FormatContactEvents(const std::vector<ContactEvent>& events)
+{
+    std::string text;
+    for (const ContactEvent& event : events)
+    {
+        if (!text.empty())
+        {
+            text += ';';
+        }
+        text += event.start.Format("%Y-%m-%dT%H:%M").ToStdString();
+        text += '|';
+        AppendEventText(text, event.title);
+        text += '|';
+        AppendEventText(text, event.notes);
+    }
+    return text;
+}
+
+// Reads the events of a contact's event field. Returns false, leaving events
+// empty, if the field is empty or holds the free text older versions wrote.
+inline bool ParseContactEvents(std::string_view text, std::vector<ContactEvent>& events)
+{
+    events.clear();
+    if (text.size() < EVENT_START_LENGTH || text[0] < '0' || text[0] > '9')
+    {
+        return false;
+    }
+
+    size_t position = 0;
+    while (position <= text.size())
+    {
+        size_t end = text.find(';', position);
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+        std::string_view entry = text.substr(position, end - position);
+        size_t titleEnd = entry.find('|', EVENT_START_LENGTH + 1);
+        ContactEvent event;
+        if (entry.size() <= EVENT_START_LENGTH || entry[EVENT_START_LENGTH] != '|' || titleEnd == std::string_view::npos
+            || !ReadEventStart(entry.substr(0, EVENT_START_LENGTH), event.start)
+            || !ReadEventText(entry.substr(EVENT_START_LENGTH + 1, titleEnd - EVENT_START_LENGTH - 1), event.title)
+            || !ReadEventText(entry.substr(titleEnd + 1), event.notes))
+        {
+            events.clear();
+            return false;
+        }
+        events.push_back(std::move(event));
+        position = end + 1;
+    }
+    return true;
+}
+
+// One line per event for display; free text is shown as it is
+inline std::string DescribeContactEvents(std::string_view text)
+{
+    std::vector<ContactEvent> events;
+    if (!ParseContactEvents(text, events))
+    {
+        return std::string(text);
+    }
+    std::string description;
+    for (const ContactEvent& event : events)
+    {
+        if (!description.empty())
+        {
+            description += "; ";
+        }
+        description += event.start.Format("%Y-%m-%d %H:%M ").ToStdString();
+        description += event.title;
+    }
+    return description;
+}
+
+// An event as the index holds it: when it starts, whose it is and its
+// position in that contact's event field
+struct EventEntry
+{
+    std::int64_t start;
+    ContactNode* contact;
+    std::uint32_t ordinal;
+};
+
+// Orders entries by start time, then by contact id; also compares an entry
+// with a bare start time, so a range is found without building an entry
+struct EventOrder
+{
+    typedef void is_transparent;
+
+    bool operator()(const EventEntry& a, const EventEntry& b) const
+    {
+        if (a.start != b.start)
+        {
+            return a.start < b.start;
+        }
+        if (a.contact != b.contact)
+        {
+            return a.contact->getId() != b.contact->getId() ? a.contact->getId() < b.contact->getId() : std::less<const ContactNode*>()(a.contact, b.contact);
+        }
+        return a.ordinal < b.ordinal;
+    }
+
+    bool operator()(const EventEntry& a, std::int64_t start) const
+    {
+        return a.start < start;
+    }
+
+    bool operator()(std::int64_t start, const EventEntry& b) const
+    {
+        return start < b.start;
+    }
+};
+
+// Every event of the stored contacts ordered by start time, so the events
+// of a day or of the coming week are found with one search plus one step
+// per event listed. Remembers the start times each contact was indexed
+// under, so the contact can be removed again after its events were edited.
+class EventIndex
+{
+    public:
+        // Milliseconds since the epoch, the order the index keeps
+        static std::int64_t TimeKey(const wxDateTime& time)
+        {
+            return time.GetValue().GetValue();
+        }
+
+        void Clear()
+        {
+            events_.clear();
+            startsByContact_.clear();
+        }
+
+        // Indexes the events parsed from the contact's event field
+        void AddContact(ContactNode* contact, const std::vector<ContactEvent>& events)
+        {
+            if (events.empty())
+            {
+                return;
+            }
+
+            std::vector<std::int64_t>& starts = startsByContact_[contact];
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                std::int64_t start = TimeKey(events[i].start);
+                events_.insert(EventEntry{start, contact, static_cast<std::uint32_t>(i)});
+                starts.push_back(start);
+            }
+        }
+
+        void RemoveContact(ContactNode* contact)
+        {
+            auto indexed = startsByContact_.find(contact);
+            if (indexed == startsByContact_.end())
+            {
+                return;
+            }
+            for (size_t i = 0; i < indexed->second.size(); i++)
+            {
+                events_.erase(EventEntry{indexed->second[i], contact, static_cast<std::uint32_t>(i)});
+            }
+            startsByContact_.erase(indexed);
+        }
+
+        // Appends the events starting in [from, to), earliest first
+        void FindBetween(const wxDateTime& from, const wxDateTime& to, std::vector<EventEntry>& found) const
+        {
+            std::int64_t end = TimeKey(to);
+            for (auto it = events_.lower_bound(TimeKey(from)); it != events_.end() && it->start < end; ++it)
+            {
+                found.push_back(*it);
+            }
+        }
+
+        // Appends the events on the given local day
+        void FindOnDate(const wxDateTime& date, std::vector<EventEntry>& found) const
+        {
+            wxDateTime day = date.GetDateOnly();
+            FindBetween(day, day + wxDateSpan::Day(), found);
+        }
+
+        size_t Size() const
+        {
+            return events_.size();
+        }
+
+    private:
+        std::set<EventEntry, EventOrder> events_;
+        std::unordered_map<const ContactNode*, std::vector<std::int64_t>> startsByContact_;
+};
+
+#endif // CONTACTEVENTS_H
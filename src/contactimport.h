@@ -0,0 +1,596 @@
+#ifndef CONTACTIMPORT_H
+#define CONTACTIMPORT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sys/stat.h>
+#include "backgroundjob.h"
+#include "contactnode.h"
+#include "contactstore.h"
+#include "phoneindex.h"
+#include "contactjournal.h"
+#include "contactcsv.h"
+#include "contactvcard.h"
+
+// Key an imported row and a stored contact must share to be the same person:
+// the trimmed, case folded first and last name plus the digits of the phone
+inline std::string ContactMatchKey(std::string_view firstName, std::string_view lastName, std::string_view phoneNumber)
+{
+    auto appendFolded = [](std::string& key, std::string_view text)
+    {
+        size_t first = text.find_first_not_of(" \t");
+        size_t last = text.find_last_not_of(" \t");
+        if (first == std::string_view::npos)
+        {
+            return;
+        }
+        for (char c : text.substr(first, last + 1 - first))
+        {
+            key += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+    };
+
+    std::string key;
+    key.reserve(firstName.size() + lastName.size() + phoneNumber.size() + 2);
+    appendFolded(key, firstName);
+    key += ' ';
+    appendFolded(key, lastName);
+    key += '\x1f';
+    for (char c : phoneNumber)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            key += c;
+        }
+    }
+    return key;
+}
+
+// contacts.txt and its journal keep fields unquoted, one record per line, so
+// commas and line breaks that CSV quoting allowed are replaced
+inline void CleanImportedField(std::string& field)
+{
+    for (char& c : field)
+    {
+        if (c == ',')
+        {
+            c = ';';
+        }
+        else if (c == '\n' || c == '\r')
+        {
+            c = ' ';
+        }
+    }
+}
+
+// What a merge import did, reported to the user once it is applied
+struct ImportSummary
+{
+    size_t rows = 0;
+    size_t added = 0;
+    size_t updated = 0;
+    size_t unchanged = 0;
+
+    // Rows whose values replaced different, non-empty values of the contact they matched
+    size_t conflicts = 0;
+
+    // Rows without a name, with an unterminated quote or card, or matching several contacts
+    size_t skipped = 0;
+
+    // Added rows whose phone number a stored contact or an earlier added row already uses
+    size_t duplicatePhones = 0;
+
+    // Lines of the first conflicting, skipped or duplicate rows
+    std::vector<size_t> reportedLines;
+};
+
+// Merges a CSV or vCard file into the stored contacts instead of replacing them.
+// Rows are streamed and hash joined on ContactMatchKey() against the
+// contacts already stored: a match has its address, company and event
+// fields updated from the row's non-empty values, anything else is added.
+// Run() only reads the store and stages the updates. Rows to add are not
+// kept, only their join keys, so memory grows with the distinct new keys
+// rather than the rows. Once Run() is done the GUI thread calls
+// ApplyUpdates(), then ReadAdditions() streams the file again on a worker
+// thread, handing the rows to add over in batches of ADD_BATCH_ROWS. The
+// GUI thread creates and journals them with AddReadRows() as they come and
+// stores them all with FinishAdditions().
+class ContactImporter
+{
+    public:
+        // Lines listed in the summary at most
+        static const size_t MAX_REPORTED_LINES = 20;
+
+        // Rows handed from ReadAdditions() to AddReadRows() at once
+        static const size_t ADD_BATCH_ROWS = 4096;
+
+        // Batches ReadAdditions() queues before it waits for AddReadRows()
+        static const size_t MAX_QUEUED_BATCHES = 8;
+
+        explicit ContactImporter(const ContactStore& store) : store_(store), queueSpace_(queueMutex_)
+        {
+
+        }
+
+        // Reads and joins the whole file, as vCard when its name ends in .vcf
+        // or .vcard and as CSV otherwise; returns false if it cannot be opened
+        // or progress was cancelled. Safe to run off the GUI thread as long as
+        // the store is not changed meanwhile. If progress is given, bytes read
+        // are published to it.
+        bool Run(const std::string& fileName, JobProgress* progress = nullptr)
+        {
+            fileName_ = fileName;
+            if (IsVcardFileName(fileName))
+            {
+                VcardReader reader(fileName);
+                return Read(reader, fileName, progress);
+            }
+            CsvReader reader(fileName);
+            return Read(reader, fileName, progress);
+        }
+
+        // Opens the file again for ReadAdditions() and updates the matched
+        // contacts, journaling each; returns them in updated. Returns false,
+        // changing nothing, if the file cannot be opened again.
+        bool ApplyUpdates(ContactStore& store, ContactJournal& journal, std::vector<ContactNode*>& updated)
+        {
+            if (IsVcardFileName(fileName_))
+            {
+                vcardReader_.reset(new VcardReader(fileName_));
+                if (!vcardReader_->IsOpen())
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                csvReader_.reset(new CsvReader(fileName_));
+                if (!csvReader_->IsOpen())
+                {
+                    return false;
+                }
+            }
+
+            for (StagedUpdate& update : updates_)
+            {
+                ContactNode* contact = update.contact;
+                const std::string* fields = update.row.fields;
+                contact->setAddress(fields[FIELD_ADDRESS]);
+                if (store.SetCompany(contact, fields[FIELD_COMPANY_NAME], fields[FIELD_COMPANY_PHONE], fields[FIELD_COMPANY_RIF]))
+                {
+                    changedCompanies_.push_back(contact->getCompanyId());
+                }
+                contact->setNewEvent(fields[FIELD_NEW_EVENT]);
+                store.Reposition(store.FindRow(contact));
+                journal.RecordUpdate(contact);
+                updated.push_back(contact);
+            }
+            updates_.clear();
+            return true;
+        }
+
+        // Streams the file again and queues the rows to add for AddReadRows(),
+        // waiting while MAX_QUEUED_BATCHES are queued. Runs off the GUI thread;
+        // the store may only be changed by AddReadRows() meanwhile. If
+        // progress is given, bytes read are published to it.
+        void ReadAdditions(JobProgress* progress = nullptr)
+        {
+            if (vcardReader_)
+            {
+                ReadAdditions(*vcardReader_, progress);
+            }
+            else if (csvReader_)
+            {
+                ReadAdditions(*csvReader_, progress);
+            }
+        }
+
+        // Creates and journals the contacts of the batches queued so far,
+        // merging later rows of a key into the contact its first row created.
+        // The contacts are not stored yet. Returns false if nothing was queued.
+        bool AddReadRows(ContactStore& store, ContactJournal& journal)
+        {
+            std::deque<std::vector<AddedRow>> batches;
+            {
+                wxMutexLocker lock(queueMutex_);
+                batches.swap(queuedBatches_);
+                queueSpace_.Broadcast();
+            }
+            for (std::vector<AddedRow>& batch : batches)
+            {
+                for (AddedRow& row : batch)
+                {
+                    AddRow(store, journal, row);
+                }
+            }
+            return !batches.empty();
+        }
+
+        // Stores the contacts AddReadRows() created and returns them in added.
+        // The contacts of a company the file renamed are appended to updated.
+        void FinishAdditions(ContactStore& store, std::vector<ContactNode*>& updated, std::vector<ContactNode*>& added)
+        {
+            store.AddAll(created_);
+            added.insert(added.end(), created_.begin(), created_.end());
+
+            std::sort(changedCompanies_.begin(), changedCompanies_.end());
+            changedCompanies_.erase(std::unique(changedCompanies_.begin(), changedCompanies_.end()), changedCompanies_.end());
+            for (std::uint32_t companyId : changedCompanies_)
+            {
+                const std::vector<ContactNode*>& members = store.GetCompanies().Get(companyId).contacts;
+                updated.insert(updated.end(), members.begin(), members.end());
+            }
+
+            created_.clear();
+            changedCompanies_.clear();
+            joinTable_.clear();
+            addedPhones_.clear();
+            csvReader_.reset();
+            vcardReader_.reset();
+        }
+
+        const ImportSummary& GetSummary() const
+        {
+            return summary_;
+        }
+
+    private:
+        struct StagedRow
+        {
+            std::string fields[FIELD_COUNT];
+        };
+
+        struct StagedUpdate
+        {
+            ContactNode* contact;
+            StagedRow row;
+        };
+
+        // A key maps to a stored contact, to a row of the file to add, or to
+        // nothing when several stored contacts share it. The contact of a
+        // row to add stays null until AddReadRows() creates it.
+        struct JoinEntry
+        {
+            ContactNode* contact;
+            size_t staged;
+            bool ambiguous;
+            bool adding;
+        };
+
+        // A row to add as ReadAdditions() read it again
+        struct AddedRow
+        {
+            JoinEntry* entry;
+            size_t line;
+            StagedRow row;
+        };
+
+        static const size_t NOT_STAGED = static_cast<size_t>(-1);
+        static constexpr ContactField UPDATED_FIELDS[] = {FIELD_ADDRESS, FIELD_COMPANY_NAME, FIELD_COMPANY_PHONE, FIELD_COMPANY_RIF, FIELD_NEW_EVENT};
+
+        const ContactStore& store_;
+        std::string fileName_;
+        std::unordered_map<std::string, JoinEntry> joinTable_;
+
+        // Normalized phone numbers of the rows to add
+        std::unordered_set<std::uint64_t> addedPhones_;
+        std::vector<StagedUpdate> updates_;
+        ImportSummary summary_;
+
+        // The file read again by ReadAdditions(), one of them open
+        std::unique_ptr<CsvReader> csvReader_;
+        std::unique_ptr<VcardReader> vcardReader_;
+
+        // Batches ReadAdditions() read and AddReadRows() did not take yet
+        wxMutex queueMutex_;
+        wxCondition queueSpace_;
+        std::deque<std::vector<AddedRow>> queuedBatches_;
+
+        // Contacts AddReadRows() created, stored by FinishAdditions()
+        std::vector<ContactNode*> created_;
+        std::vector<std::uint32_t> changedCompanies_;
+
+        template <typename Reader>
+        void ReadAdditions(Reader& reader, JobProgress* progress)
+        {
+            if (progress)
+            {
+                struct stat fileStat;
+                progress->total = stat(fileName_.c_str(), &fileStat) == 0 ? static_cast<std::uint64_t>(fileStat.st_size) : 0;
+            }
+
+            std::vector<AddedRow> batch;
+            std::vector<std::string> fields;
+            while (reader.ReadRecord(fields))
+            {
+                fields.resize(FIELD_COUNT);
+                for (std::string& field : fields)
+                {
+                    CleanImportedField(field);
+                }
+                if (reader.IsMalformed() || (fields[FIELD_FIRST_NAME].empty() && fields[FIELD_LAST_NAME].empty()))
+                {
+                    continue;
+                }
+
+                // Only Run() adds keys, so finding one here does not race with AddReadRows()
+                auto it = joinTable_.find(ContactMatchKey(fields[FIELD_FIRST_NAME], fields[FIELD_LAST_NAME], fields[FIELD_PHONE_NUMBER]));
+                if (it == joinTable_.end() || !it->second.adding)
+                {
+                    continue;
+                }
+
+                batch.emplace_back();
+                AddedRow& row = batch.back();
+                row.entry = &it->second;
+                row.line = reader.GetRecordLine();
+                for (int field = 0; field < FIELD_COUNT; field++)
+                {
+                    row.row.fields[field] = std::move(fields[field]);
+                }
+                if (batch.size() == ADD_BATCH_ROWS)
+                {
+                    QueueBatch(batch);
+                    if (progress)
+                    {
+                        progress->done = reader.GetBytesRead();
+                    }
+                }
+            }
+            if (!batch.empty())
+            {
+                QueueBatch(batch);
+            }
+            if (progress)
+            {
+                progress->done = reader.GetBytesRead();
+            }
+        }
+
+        // Waits while MAX_QUEUED_BATCHES are queued, except on the GUI thread,
+        // which would wait for itself
+        void QueueBatch(std::vector<AddedRow>& batch)
+        {
+            wxMutexLocker lock(queueMutex_);
+            while (queuedBatches_.size() >= MAX_QUEUED_BATCHES && !wxThread::IsMain())
+            {
+                queueSpace_.Wait();
+            }
+            queuedBatches_.push_back(std::move(batch));
+            batch.clear();
+        }
+
+        // Reads records from a CsvReader or a VcardReader and joins them
+        template <typename Reader>
+        bool Read(Reader& reader, const std::string& fileName, JobProgress* progress)
+        {
+            // Rows read between two progress updates and cancel checks
+            const size_t PROGRESS_STEP = 1024;
+
+            if (!reader.IsOpen())
+            {
+                return false;
+            }
+
+            if (progress)
+            {
+                struct stat fileStat;
+                progress->total = stat(fileName.c_str(), &fileStat) == 0 ? static_cast<std::uint64_t>(fileStat.st_size) : 0;
+            }
+
+            BuildJoinTable();
+
+            std::vector<std::string> fields;
+            while (reader.ReadRecord(fields))
+            {
+                if (progress && summary_.rows % PROGRESS_STEP == 0)
+                {
+                    if (progress->IsCancelled())
+                    {
+                        return false;
+                    }
+                    progress->done = reader.GetBytesRead();
+                }
+
+                summary_.rows++;
+                fields.resize(FIELD_COUNT);
+                for (std::string& field : fields)
+                {
+                    CleanImportedField(field);
+                }
+                if (reader.IsMalformed() || (fields[FIELD_FIRST_NAME].empty() && fields[FIELD_LAST_NAME].empty()))
+                {
+                    Skip(reader.GetRecordLine());
+                    continue;
+                }
+                JoinRow(fields, reader.GetRecordLine());
+            }
+
+            if (progress)
+            {
+                progress->done = reader.GetBytesRead();
+            }
+            return !progress || !progress->IsCancelled();
+        }
+
+        void BuildJoinTable()
+        {
+            joinTable_.clear();
+            joinTable_.reserve(store_.Size());
+            for (ContactNode* contact : store_.GetContacts())
+            {
+                std::string key = ContactMatchKey(contact->getFirstName(), contact->getLastName(), contact->getPhoneNumber());
+                auto inserted = joinTable_.emplace(std::move(key), JoinEntry{contact, NOT_STAGED, false, false});
+                if (!inserted.second)
+                {
+                    inserted.first->second.ambiguous = true;
+                }
+            }
+        }
+
+        void JoinRow(std::vector<std::string>& fields, size_t line)
+        {
+            std::string key = ContactMatchKey(fields[FIELD_FIRST_NAME], fields[FIELD_LAST_NAME], fields[FIELD_PHONE_NUMBER]);
+            auto it = joinTable_.find(key);
+            if (it == joinTable_.end())
+            {
+                joinTable_.emplace(std::move(key), JoinEntry{nullptr, NOT_STAGED, false, true});
+                std::uint64_t phoneKey;
+                bool sharedInFile = NormalizePhoneNumber(fields[FIELD_PHONE_NUMBER], phoneKey) && !addedPhones_.insert(phoneKey).second;
+                if (sharedInFile || store_.FindPhoneDuplicate(fields[FIELD_PHONE_NUMBER]))
+                {
+                    summary_.duplicatePhones++;
+                    Report(line);
+                }
+                summary_.added++;
+                return;
+            }
+
+            // Later rows of a key being added are merged and counted by AddReadRows()
+            JoinEntry& entry = it->second;
+            if (entry.adding)
+            {
+                return;
+            }
+            if (entry.ambiguous)
+            {
+                Skip(line);
+                return;
+            }
+
+            // The row merges into what this import already staged for the contact, if anything
+            StagedRow* target = entry.staged != NOT_STAGED ? &updates_[entry.staged].row : nullptr;
+            bool changed = CountMerge(fields.data(), line, [&](ContactField field)
+            {
+                return target ? std::string_view(target->fields[field]) : entry.contact->getField(field);
+            });
+            if (!changed)
+            {
+                return;
+            }
+
+            if (!target)
+            {
+                StagedUpdate update;
+                update.contact = entry.contact;
+                for (int field = 0; field < FIELD_COUNT; field++)
+                {
+                    update.row.fields[field] = std::string(entry.contact->getField(static_cast<ContactField>(field)));
+                }
+                entry.staged = updates_.size();
+                updates_.push_back(std::move(update));
+                target = &updates_.back().row;
+            }
+            for (ContactField field : UPDATED_FIELDS)
+            {
+                if (!fields[field].empty())
+                {
+                    target->fields[field] = std::move(fields[field]);
+                }
+            }
+        }
+
+        // Creates and journals the contact of the first row of a key being
+        // added, and merges the later rows of that key into it
+        void AddRow(ContactStore& store, ContactJournal& journal, AddedRow& added)
+        {
+            const std::string* fields = added.row.fields;
+            ContactNode*& contact = added.entry->contact;
+            if (!contact)
+            {
+                contact = store.CreateContact(fields[FIELD_FIRST_NAME], fields[FIELD_LAST_NAME], fields[FIELD_PHONE_NUMBER], fields[FIELD_ADDRESS], fields[FIELD_COMPANY_NAME], fields[FIELD_COMPANY_PHONE], fields[FIELD_COMPANY_RIF], fields[FIELD_NEW_EVENT]);
+                if (store.UpdateCompany(fields[FIELD_COMPANY_RIF], fields[FIELD_COMPANY_NAME], fields[FIELD_COMPANY_PHONE]))
+                {
+                    changedCompanies_.push_back(contact->getCompanyId());
+                }
+                contact->setId(journal.NextId());
+                journal.RecordAdd(contact);
+                created_.push_back(contact);
+                return;
+            }
+
+            ContactNode* target = contact;
+            if (!CountMerge(fields, added.line, [target](ContactField field) { return target->getField(field); }))
+            {
+                return;
+            }
+            if (!fields[FIELD_ADDRESS].empty())
+            {
+                contact->setAddress(fields[FIELD_ADDRESS]);
+            }
+            if (!fields[FIELD_COMPANY_NAME].empty() || !fields[FIELD_COMPANY_PHONE].empty() || !fields[FIELD_COMPANY_RIF].empty())
+            {
+                std::string companyName = fields[FIELD_COMPANY_NAME].empty() ? std::string(contact->getCompanyName()) : fields[FIELD_COMPANY_NAME];
+                std::string companyPhone = fields[FIELD_COMPANY_PHONE].empty() ? std::string(contact->getCompanyPhone()) : fields[FIELD_COMPANY_PHONE];
+                std::string companyRif = fields[FIELD_COMPANY_RIF].empty() ? std::string(contact->getCompanyRif()) : fields[FIELD_COMPANY_RIF];
+                if (store.SetCompany(contact, companyName, companyPhone, companyRif))
+                {
+                    changedCompanies_.push_back(contact->getCompanyId());
+                }
+            }
+            if (!fields[FIELD_NEW_EVENT].empty())
+            {
+                contact->setNewEvent(fields[FIELD_NEW_EVENT]);
+            }
+
+            // Already journaled as added, the merged values follow as an update
+            journal.RecordUpdate(contact);
+        }
+
+        // Counts a row merged into the values its key already has as updated
+        // or unchanged, and as a conflict if it replaces a different non-empty
+        // value. Returns true if it changes anything.
+        template <typename CurrentValue>
+        bool CountMerge(const std::string* fields, size_t line, CurrentValue currentValue)
+        {
+            bool changed = false;
+            bool conflict = false;
+            for (ContactField field : UPDATED_FIELDS)
+            {
+                std::string_view current = currentValue(field);
+                if (fields[field].empty() || fields[field] == current)
+                {
+                    continue;
+                }
+                conflict = conflict || !current.empty();
+                changed = true;
+            }
+
+            if (!changed)
+            {
+                summary_.unchanged++;
+                return false;
+            }
+            summary_.updated++;
+            if (conflict)
+            {
+                summary_.conflicts++;
+                Report(line);
+            }
+            return true;
+        }
+
+        void Skip(size_t line)
+        {
+            summary_.skipped++;
+            Report(line);
+        }
+
+        void Report(size_t line)
+        {
+            if (summary_.reportedLines.size() < MAX_REPORTED_LINES)
+            {
+                summary_.reportedLines.push_back(line);
+            }
+        }
+};
+
+#endif // CONTACTIMPORT_H
@@ -0,0 +1,299 @@
+#ifndef CONTACTJOURNAL_H
+#define CONTACTJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "contactnode.h"
+#include "contactsnapshot.h"
+#include "contactstore.h"
+#include "contactloader.h"
+#include "contactwriter.h"
+
+// Append-only journal of contact mutations next to contacts.txt.
+// Every add, update and delete appends one line instead of rewriting the
+// whole agenda:
+//
+//     A <id> <record line>    contact added
+//     U <id> <record line>    contact updated
+//     D <id>                  contact deleted
+//
+// contacts.txt lines carry the contact id as a ninth field, so replaying a
+// journal that is already folded into the file leaves it unchanged. Once the
+// journal passes COMPACT_THRESHOLD bytes the live contacts are written to
+// contacts.txt and the journal is emptied. All writes go through one
+// ContactWriter thread, in order, so a crash at any point loses nothing that
+// reached the disk. Loading replays contacts.txt, then <journal>.old (left by
+// older versions), then the journal.
+// Whenever contacts.txt is written a binary snapshot of it is written too;
+// while it matches contacts.txt, loading maps it instead of parsing text.
+class ContactJournal
+{
+    public:
+        // Journal size that triggers a background compaction
+        static const std::uint64_t COMPACT_THRESHOLD = 4 * 1024 * 1024;
+
+        ContactJournal(const std::string& fileName) : fileName_(fileName), journalName_(fileName + ".journal"), oldJournalName_(fileName + ".journal.old"), snapshotName_(fileName + ".snap"), nextId_(0), journalBytes_(0), writer_(fileName_, journalName_, oldJournalName_, snapshotName_)
+        {
+            writer_.Start();
+        }
+
+        ContactJournal(const ContactJournal&) = delete;
+        ContactJournal& operator=(const ContactJournal&) = delete;
+
+        ~ContactJournal()
+        {
+            writer_.Stop();
+        }
+
+        // Reads contacts.txt, replays the journals on top of it and returns the
+        // live contacts, created in the given store but not yet stored in it.
+        // Files from before the journal existed have no ids, in which case
+        // contacts.txt is rewritten once with them.
+        void Load(ContactStore& store, std::vector<ContactNode*>& contacts)
+        {
+            writer_.Flush();
+
+            std::unordered_map<std::uint32_t, ContactNode*> contactsById;
+            std::vector<ContactNode*> withoutId;
+            bool rewrite = false;
+            nextId_ = 0;
+
+            std::shared_ptr<ContactSnapshot> snapshot = std::make_shared<ContactSnapshot>();
+            if (snapshot->Open(snapshotName_, fileName_))
+            {
+                // Contacts read their fields in place from the mapping
+                store.AdoptSnapshot(snapshot);
+                contactsById.reserve(snapshot->Size());
+                for (size_t row = 0; row < snapshot->Size(); row++)
+                {
+                    Upsert(store, contactsById, store.CreateContact(*snapshot, row));
+                }
+            }
+            else
+            {
+                // Parsed on every core, contacts then read their fields from the loaded buffer
+                ContactFileLoader loader;
+                loader.Load(fileName_);
+                for (const std::vector<ParsedContact>& batch : loader.GetBatches())
+                {
+                    for (const ParsedContact& parsed : batch)
+                    {
+                        ContactNode* contact = store.CreateContact(parsed.data, parsed.lengths, parsed.id);
+                        if (parsed.hasId)
+                        {
+                            Upsert(store, contactsById, contact);
+                        }
+                        else
+                        {
+                            withoutId.push_back(contact);
+                        }
+                    }
+                }
+                store.AdoptBuffer(loader.TakeBuffer());
+
+                // Write the snapshot the next start will map
+                rewrite = true;
+            }
+
+            // Number the old contacts after any id already in use
+            for (ContactNode* contact : withoutId)
+            {
+                contact->setId(nextId_);
+                Upsert(store, contactsById, contact);
+                rewrite = true;
+            }
+
+            std::ifstream oldJournal(oldJournalName_);
+            if (oldJournal.is_open())
+            {
+                Replay(store, oldJournal, contactsById);
+                rewrite = true;
+            }
+            oldJournal.close();
+
+            std::ifstream journal(journalName_);
+            Replay(store, journal, contactsById);
+            journal.close();
+
+            contacts.clear();
+            contacts.reserve(contactsById.size());
+            for (const auto& entry : contactsById)
+            {
+                contacts.push_back(entry.second);
+            }
+
+            if (rewrite)
+            {
+                Rewrite(contacts);
+            }
+            else
+            {
+                journalBytes_ = FileSize(journalName_);
+            }
+        }
+
+        // Id for a contact that is about to be added
+        std::uint32_t NextId()
+        {
+            return nextId_++;
+        }
+
+        void RecordAdd(const ContactNode* contact)
+        {
+            Append("A " + std::to_string(contact->getId()) + " " + contact->getRecordLine());
+        }
+
+        void RecordUpdate(const ContactNode* contact)
+        {
+            Append("U " + std::to_string(contact->getId()) + " " + contact->getRecordLine());
+        }
+
+        void RecordDelete(const ContactNode* contact)
+        {
+            Append("D " + std::to_string(contact->getId()));
+        }
+
+        // Folds the journal into contacts.txt in the background once it is big enough
+        void CompactIfNeeded(const std::vector<ContactNode*>& contacts)
+        {
+            if (journalBytes_ >= COMPACT_THRESHOLD)
+            {
+                Rewrite(contacts);
+            }
+        }
+
+        // Queues writing every contact to contacts.txt and emptying the journals.
+        // Only the record bytes are copied here; the writer thread sorts and
+        // formats the lines.
+        void Rewrite(const std::vector<ContactNode*>& contacts)
+        {
+            ContactRecords records = CopyRecords(contacts);
+            writer_.WriteAll(records);
+            journalBytes_ = 0;
+        }
+
+    private:
+        std::string fileName_;
+        std::string journalName_;
+        std::string oldJournalName_;
+        std::string snapshotName_;
+        std::uint32_t nextId_;
+        std::uint64_t journalBytes_;
+        ContactWriter writer_;
+
+        static std::uint64_t FileSize(const std::string& name)
+        {
+            struct stat info;
+            return stat(name.c_str(), &info) == 0 ? static_cast<std::uint64_t>(info.st_size) : 0;
+        }
+
+        void Append(const std::string& record)
+        {
+            writer_.Append(record + "\n");
+            journalBytes_ += record.size() + 1;
+        }
+
+        // Splits a contacts.txt line, the ninth field being the id if present
+        ContactNode* ParseRecord(ContactStore& store, const std::string& line, bool& hasId)
+        {
+            std::vector<std::string> fields;
+            SplitContactRecord(line, fields);
+            const std::string& id = fields[FIELD_COUNT];
+
+            ContactNode* contact = store.CreateContact(fields[FIELD_FIRST_NAME], fields[FIELD_LAST_NAME], fields[FIELD_PHONE_NUMBER], fields[FIELD_ADDRESS], fields[FIELD_COMPANY_NAME], fields[FIELD_COMPANY_PHONE], fields[FIELD_COMPANY_RIF], fields[FIELD_NEW_EVENT]);
+
+            // Replayed in order, so the latest record names the company
+            store.UpdateCompany(fields[FIELD_COMPANY_RIF], fields[FIELD_COMPANY_NAME], fields[FIELD_COMPANY_PHONE]);
+            hasId = !id.empty() && id.find_first_not_of("0123456789") == std::string::npos;
+            if (hasId)
+            {
+                contact->setId(static_cast<std::uint32_t>(std::strtoul(id.c_str(), nullptr, 10)));
+            }
+            return contact;
+        }
+
+        void Upsert(ContactStore& store, std::unordered_map<std::uint32_t, ContactNode*>& contactsById, ContactNode* contact)
+        {
+            ContactNode*& slot = contactsById[contact->getId()];
+            if (slot)
+            {
+                store.DestroyContact(slot);
+            }
+            slot = contact;
+            nextId_ = std::max(nextId_, contact->getId() + 1);
+        }
+
+        void Replay(ContactStore& store, std::istream& journal, std::unordered_map<std::uint32_t, ContactNode*>& contactsById)
+        {
+            std::string line;
+            while (std::getline(journal, line))
+            {
+                // A torn last line from a crash has no valid header, skip it
+                if (line.size() < 3 || line[1] != ' ')
+                {
+                    continue;
+                }
+
+                size_t idEnd = line.find(' ', 2);
+                std::string id = line.substr(2, idEnd == std::string::npos ? std::string::npos : idEnd - 2);
+                if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos)
+                {
+                    continue;
+                }
+                std::uint32_t contactId = static_cast<std::uint32_t>(std::strtoul(id.c_str(), nullptr, 10));
+
+                if (line[0] == 'D')
+                {
+                    auto it = contactsById.find(contactId);
+                    if (it != contactsById.end())
+                    {
+                        store.DestroyContact(it->second);
+                        contactsById.erase(it);
+                    }
+                    nextId_ = std::max(nextId_, contactId + 1);
+                }
+                else if ((line[0] == 'A' || line[0] == 'U') && idEnd != std::string::npos)
+                {
+                    bool hasId = false;
+                    ContactNode* contact = ParseRecord(store, line.substr(idEnd + 1), hasId);
+                    contact->setId(contactId);
+                    Upsert(store, contactsById, contact);
+                }
+            }
+        }
+
+        // Copies the record of every contact into one buffer, without
+        // building a string per contact, so the store may change meanwhile
+        static ContactRecords CopyRecords(const std::vector<ContactNode*>& contacts)
+        {
+            ContactRecords records;
+            records.entries.reserve(contacts.size());
+            for (const ContactNode* contact : contacts)
+            {
+                ContactRecords::Entry entry;
+                entry.id = contact->getId();
+                entry.offset = records.text.size();
+                for (int i = 0; i < FIELD_COUNT; i++)
+                {
+                    if (i > 0)
+                    {
+                        records.text += ',';
+                    }
+                    records.text += contact->getField(static_cast<ContactField>(i));
+                }
+                entry.length = records.text.size() - entry.offset;
+                records.entries.push_back(entry);
+            }
+            return records;
+        }
+};
+
+#endif // CONTACTJOURNAL_H
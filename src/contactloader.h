@@ -0,0 +1,195 @@
+#ifndef CONTACTLOADER_H
+#define CONTACTLOADER_H
+
+#include <wx/thread.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "contactsnapshot.h"
+#include "delimiterscanner.h"
+
+// One parsed contacts.txt line. The eight fields sit back to back at data,
+// inside the loader's buffer, the same layout a snapshot record has.
+struct ParsedContact
+{
+    const char* data;
+    std::uint32_t lengths[FIELD_COUNT];
+    std::uint32_t id;
+    bool hasId;
+};
+
+// Parses the lines of [begin, end) into contacts. Each line is rewritten in
+// place without its commas, so the chunk must not be shared with another parser.
+inline void ParseContactChunk(char* begin, char* end, std::vector<ParsedContact>& contacts)
+{
+    // One pass finds both the commas and the line ends
+    DelimiterScanner scanner(begin, end, ',', '\n');
+    char* line = begin;
+    while (line < end)
+    {
+        ParsedContact contact;
+        contact.data = line;
+        contact.id = 0;
+        contact.hasId = false;
+
+        // Same split as SplitContactRecord: eight fields then the id, anything after is ignored
+        char* out = line;
+        char* in = line;
+        char* lineEnd = end;
+        int field = 0;
+        while (true)
+        {
+            char* delimiter = const_cast<char*>(scanner.Next());
+            if (field < FIELD_COUNT)
+            {
+                size_t length = delimiter - in;
+                std::memmove(out, in, length);
+                out += length;
+                contact.lengths[field] = static_cast<std::uint32_t>(length);
+            }
+            else if (field == FIELD_COUNT)
+            {
+                contact.hasId = delimiter > in;
+                for (const char* digit = in; digit < delimiter && contact.hasId; digit++)
+                {
+                    contact.hasId = *digit >= '0' && *digit <= '9';
+                    contact.id = contact.id * 10 + static_cast<std::uint32_t>(*digit - '0');
+                }
+            }
+            field++;
+
+            if (delimiter == end || *delimiter == '\n')
+            {
+                lineEnd = delimiter;
+                break;
+            }
+            in = delimiter + 1;
+        }
+
+        for (; field < FIELD_COUNT; field++)
+        {
+            contact.lengths[field] = 0;
+        }
+        if (!contact.hasId)
+        {
+            contact.id = 0;
+        }
+
+        if (lineEnd > line)
+        {
+            contacts.push_back(contact);
+        }
+        line = lineEnd + 1;
+    }
+}
+
+// Parses one chunk of contacts.txt on a worker thread
+class ContactChunkParser : public wxThread
+{
+    public:
+        ContactChunkParser(char* begin, char* end, std::vector<ParsedContact>& contacts) : wxThread(wxTHREAD_JOINABLE), begin_(begin), end_(end), contacts_(contacts)
+        {
+
+        }
+
+    protected:
+        ExitCode Entry() override
+        {
+            ParseContactChunk(begin_, end_, contacts_);
+            return static_cast<ExitCode>(0);
+        }
+
+    private:
+        char* begin_;
+        char* end_;
+        std::vector<ParsedContact>& contacts_;
+};
+
+// Reads contacts.txt in one go and parses it in newline aligned chunks, one
+// per core. Batches come back in file order, so merging them keeps the order
+// the sequential parser had.
+class ContactFileLoader
+{
+    public:
+        // Smaller files are parsed on the calling thread
+        static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+        // Returns false if the file could not be read
+        bool Load(const std::string& fileName)
+        {
+            batches_.clear();
+
+            std::ifstream inputFile(fileName, std::ios::binary | std::ios::ate);
+            if (!inputFile.is_open())
+            {
+                return false;
+            }
+            size_t size = static_cast<size_t>(inputFile.tellg());
+            buffer_.reset(new char[size + 1]);
+            inputFile.seekg(0);
+            if (size > 0 && !inputFile.read(buffer_.get(), size))
+            {
+                return false;
+            }
+
+            int cpuCount = wxThread::GetCPUCount();
+            size_t chunkCount = std::max<size_t>(1, std::min<size_t>(cpuCount > 0 ? cpuCount : 1, size / MIN_CHUNK_SIZE));
+
+            // Each chunk ends right after a newline so no line is split
+            std::vector<char*> bounds(1, buffer_.get());
+            for (size_t chunk = 1; chunk < chunkCount; chunk++)
+            {
+                char* bound = buffer_.get() + size * chunk / chunkCount;
+                bound = std::max(bound, bounds.back());
+                char* newline = static_cast<char*>(std::memchr(bound, '\n', buffer_.get() + size - bound));
+                bounds.push_back(newline ? newline + 1 : buffer_.get() + size);
+            }
+            bounds.push_back(buffer_.get() + size);
+
+            batches_.resize(chunkCount);
+            std::vector<ContactChunkParser*> parsers;
+            for (size_t chunk = 1; chunk < chunkCount; chunk++)
+            {
+                ContactChunkParser* parser = new ContactChunkParser(bounds[chunk], bounds[chunk + 1], batches_[chunk]);
+                if (parser->Run() == wxTHREAD_NO_ERROR)
+                {
+                    parsers.push_back(parser);
+                }
+                else
+                {
+                    // No thread available, parse it here instead
+                    delete parser;
+                    ParseContactChunk(bounds[chunk], bounds[chunk + 1], batches_[chunk]);
+                }
+            }
+
+            ParseContactChunk(bounds[0], bounds[1], batches_[0]);
+            for (ContactChunkParser* parser : parsers)
+            {
+                parser->Wait();
+                delete parser;
+            }
+            return true;
+        }
+
+        const std::vector<std::vector<ParsedContact>>& GetBatches() const
+        {
+            return batches_;
+        }
+
+        // Hands over the buffer the parsed fields point into
+        std::unique_ptr<char[]> TakeBuffer()
+        {
+            return std::move(buffer_);
+        }
+
+    private:
+        std::unique_ptr<char[]> buffer_;
+        std::vector<std::vector<ParsedContact>> batches_;
+};
+
+#endif // CONTACTLOADER_H
@@ -0,0 +1,341 @@
+#ifndef CONTACTNODE_H
+#define CONTACTNODE_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include "contactarena.h"
+#include "contactsnapshot.h"
+#include "textfold.h"
+
+// A contact of the agenda. Its eight fields live back to back in the arena
+// of the owning store (or in a mapped snapshot), the node itself only holds
+// where they start and how long each one is. Setters write a fresh copy of
+// the record to the arena. Getters return views into those bytes, valid
+// until the contact is changed or the store compacts its arena.
+// A contact working at a company of the arena's company table only keeps its
+// id; the company name, phone and RIF are read from the table.
+class ContactNode
+{
+    public:
+        ContactNode(ContactArena* arena, const std::string& firstName, const std::string& lastName, const std::string& phoneNumber, const std::string& address, const std::string& companyName, const std::string& companyPhone, const std::string& companyRif, const std::string& newEvent) : arena_(arena), data_(nullptr), sortKey_(nullptr), sortKeyLength_(0), id_(0), companyId_(CompanyTable::NO_COMPANY), ownsData_(false)
+        {
+            std::string_view fields[FIELD_COUNT] = {firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent};
+            store(fields);
+            storeSortKey();
+        }
+
+        // Contact read in place from bytes the arena keeps alive, such as a
+        // mapped snapshot record or a line of a loaded contacts.txt
+        ContactNode(ContactArena* arena, const char* data, const std::uint32_t* lengths, std::uint32_t id) : arena_(arena), data_(data), sortKey_(nullptr), sortKeyLength_(0), id_(id), companyId_(CompanyTable::NO_COMPANY), ownsData_(false)
+        {
+            std::memcpy(lengths_, lengths, sizeof(lengths_));
+            storeSortKey();
+        }
+
+        std::string_view getFirstName() const
+        {
+            return field(FIELD_FIRST_NAME);
+        }
+
+        std::string_view getLastName() const
+        {
+            return field(FIELD_LAST_NAME);
+        }
+
+        // Composed for display, sorting goes through getSortKey()
+        std::string getFullName() const
+        {
+            std::string fullName;
+            fullName.reserve(lengths_[FIELD_FIRST_NAME] + 1 + lengths_[FIELD_LAST_NAME]);
+            fullName += getFirstName();
+            fullName += ' ';
+            fullName += getLastName();
+            return fullName;
+        }
+
+        // Full name folded to lower case, kept in the arena and only rebuilt when a name changes
+        std::string_view getSortKey() const
+        {
+            return std::string_view(sortKey_, sortKeyLength_);
+        }
+
+        std::string_view getPhoneNumber() const
+        {
+            return field(FIELD_PHONE_NUMBER);
+        }
+
+        std::string_view getAddress() const
+        {
+            return field(FIELD_ADDRESS);
+        }
+
+        std::string_view getCompanyName() const
+        {
+            return field(FIELD_COMPANY_NAME);
+        }
+
+        std::string_view getCompanyPhone() const
+        {
+            return field(FIELD_COMPANY_PHONE);
+        }
+
+        std::string_view getCompanyRif() const
+        {
+            return field(FIELD_COMPANY_RIF);
+        }
+
+        std::string_view getNewEvent() const
+        {
+            return field(FIELD_NEW_EVENT);
+        }
+
+        std::string_view getField(ContactField which) const
+        {
+            return field(which);
+        }
+
+        // Identifies the contact in contacts.txt and its journal
+        std::uint32_t getId() const
+        {
+            return id_;
+        }
+
+        // Id of the contact's company in the arena's company table, or CompanyTable::NO_COMPANY
+        std::uint32_t getCompanyId() const
+        {
+            return companyId_;
+        }
+
+        void setFirstName(const std::string& firstName)
+        {
+            setField(FIELD_FIRST_NAME, firstName);
+            storeSortKey();
+        }
+
+        void setLastName(const std::string& lastName)
+        {
+            setField(FIELD_LAST_NAME, lastName);
+            storeSortKey();
+        }
+
+        void setPhoneNumber(const std::string& phoneNumber)
+        {
+            setField(FIELD_PHONE_NUMBER, phoneNumber);
+        }
+
+        void setAddress(const std::string& address)
+        {
+            setField(FIELD_ADDRESS, address);
+        }
+
+        // Company fields kept in the record itself, for a contact without a
+        // company in the table
+        void setCompanyFields(const std::string& companyName, const std::string& companyPhone, const std::string& companyRif)
+        {
+            std::string_view fields[FIELD_COUNT];
+            getFields(fields);
+            fields[FIELD_COMPANY_NAME] = companyName;
+            fields[FIELD_COMPANY_PHONE] = companyPhone;
+            fields[FIELD_COMPANY_RIF] = companyRif;
+            store(fields);
+        }
+
+        // Links the contact to a company of the table. Company fields still
+        // in an owned record are dropped; a record read in place keeps them,
+        // unread, until it is next copied.
+        void setCompanyId(std::uint32_t companyId)
+        {
+            companyId_ = companyId;
+            if (companyId_ != CompanyTable::NO_COMPANY && ownsData_ && lengths_[FIELD_COMPANY_NAME] + lengths_[FIELD_COMPANY_PHONE] + lengths_[FIELD_COMPANY_RIF] > 0)
+            {
+                std::string_view fields[FIELD_COUNT];
+                getFields(fields);
+                store(fields);
+            }
+        }
+
+        void setNewEvent(const std::string& newEvent)
+        {
+            setField(FIELD_NEW_EVENT, newEvent);
+        }
+
+        void setId(std::uint32_t id)
+        {
+            id_ = id;
+        }
+
+        // Comma separated line as stored in contacts.txt
+        std::string getRecordLine() const
+        {
+            std::string line;
+            line.reserve(getRecordSize() + FIELD_COUNT - 1);
+            for (int i = 0; i < FIELD_COUNT; i++)
+            {
+                if (i > 0)
+                {
+                    line += ',';
+                }
+                line += field(static_cast<ContactField>(i));
+            }
+            return line;
+        }
+
+        bool operator<(const ContactNode& other) const
+        {
+            return getSortKey() < other.getSortKey();
+        }
+
+        // Copies the fields and sort key into the arena again, used when the store compacts it
+        void relocate()
+        {
+            if (ownsData_)
+            {
+                std::string_view fields[FIELD_COUNT];
+                getFields(fields);
+                ownsData_ = false;
+                store(fields);
+            }
+
+            char* sortKey = arena_->Allocate(sortKeyLength_);
+            if (sortKeyLength_ > 0)
+            {
+                std::memcpy(sortKey, sortKey_, sortKeyLength_);
+            }
+            sortKey_ = sortKey;
+        }
+
+        // Gives the arena bytes back before the node is reused
+        void release()
+        {
+            if (ownsData_)
+            {
+                arena_->Release(getRecordSize());
+            }
+            arena_->Release(sortKeyLength_);
+            data_ = nullptr;
+            ownsData_ = false;
+            sortKey_ = nullptr;
+            sortKeyLength_ = 0;
+        }
+
+    private:
+        ContactArena* arena_;
+        const char* data_;
+        std::uint32_t lengths_[FIELD_COUNT];
+        const char* sortKey_;
+        std::uint32_t sortKeyLength_;
+        std::uint32_t id_;
+        std::uint32_t companyId_;
+        bool ownsData_;
+
+        static bool isCompanyField(int which)
+        {
+            return which == FIELD_COMPANY_NAME || which == FIELD_COMPANY_PHONE || which == FIELD_COMPANY_RIF;
+        }
+
+        std::string_view field(ContactField which) const
+        {
+            if (companyId_ != CompanyTable::NO_COMPANY && isCompanyField(which))
+            {
+                const Company& company = arena_->GetCompanies().Get(companyId_);
+                return which == FIELD_COMPANY_NAME ? company.name : which == FIELD_COMPANY_PHONE ? company.phone : company.rif;
+            }
+
+            const char* start = data_;
+            for (int i = 0; i < which; i++)
+            {
+                start += lengths_[i];
+            }
+            return std::string_view(start, lengths_[which]);
+        }
+
+        void getFields(std::string_view* fields) const
+        {
+            const char* start = data_;
+            for (int i = 0; i < FIELD_COUNT; i++)
+            {
+                fields[i] = std::string_view(start, lengths_[i]);
+                start += lengths_[i];
+            }
+        }
+
+        size_t getRecordSize() const
+        {
+            size_t size = 0;
+            for (std::uint32_t length : lengths_)
+            {
+                size += length;
+            }
+            return size;
+        }
+
+        void setField(ContactField which, const std::string& value)
+        {
+            std::string_view fields[FIELD_COUNT];
+            getFields(fields);
+            fields[which] = value;
+            store(fields);
+        }
+
+        // Writes the record to fresh arena bytes; the old bytes stay valid until
+        // the store compacts, so the fields may point into them. The company
+        // fields are left empty while the company table holds them.
+        void store(const std::string_view* fields)
+        {
+            std::string_view record[FIELD_COUNT];
+            size_t size = 0;
+            for (int i = 0; i < FIELD_COUNT; i++)
+            {
+                if (companyId_ == CompanyTable::NO_COMPANY || !isCompanyField(i))
+                {
+                    record[i] = fields[i];
+                }
+                size += record[i].size();
+            }
+
+            if (ownsData_)
+            {
+                // The replaced record is only counted as garbage
+                arena_->Release(getRecordSize());
+            }
+
+            char* data = arena_->Allocate(size);
+            char* out = data;
+            for (int i = 0; i < FIELD_COUNT; i++)
+            {
+                if (!record[i].empty())
+                {
+                    std::memcpy(out, record[i].data(), record[i].size());
+                }
+                out += record[i].size();
+                lengths_[i] = static_cast<std::uint32_t>(record[i].size());
+            }
+
+            data_ = data;
+            ownsData_ = true;
+        }
+
+        void storeSortKey()
+        {
+            arena_->Release(sortKeyLength_);
+
+            std::string_view firstName = getFirstName();
+            std::string_view lastName = getLastName();
+            size_t allocated = firstName.size() + 1 + lastName.size();
+            char* sortKey = arena_->Allocate(allocated);
+
+            // Accented Latin-1 letters sort with their base letter, "Ángel" among the a's
+            size_t length = FoldTextTo(sortKey, firstName);
+            sortKey[length++] = ' ';
+            length += FoldTextTo(sortKey + length, lastName);
+
+            // Folding can only shorten the key, the tail is garbage
+            arena_->Release(allocated - length);
+            sortKey_ = sortKey;
+            sortKeyLength_ = static_cast<std::uint32_t>(length);
+        }
+};
+
+#endif // CONTACTNODE_H
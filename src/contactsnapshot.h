@@ -0,0 +1,271 @@
+#ifndef CONTACTSNAPSHOT_H
+#define CONTACTSNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomicfile.h"
+
+// Order of the fields of a contact record, in contacts.txt and in the snapshot
+enum ContactField
+{
+    FIELD_FIRST_NAME,
+    FIELD_LAST_NAME,
+    FIELD_PHONE_NUMBER,
+    FIELD_ADDRESS,
+    FIELD_COMPANY_NAME,
+    FIELD_COMPANY_PHONE,
+    FIELD_COMPANY_RIF,
+    FIELD_NEW_EVENT,
+    FIELD_COUNT
+};
+
+// Binary snapshot of contacts.txt, laid out as
+//
+//     SnapshotHeader
+//     SnapshotRecord[recordCount]     fixed width, one per contact
+//     char heap[heapSize]             the fields of each record back to back
+//
+// The file is mapped read-only and fields are returned as views into the
+// mapping, so opening it costs nothing per contact until a field is read.
+// It only describes the contacts.txt whose size and modification time are
+// stored in the header; any other contacts.txt makes it stale.
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t fieldCount;
+    std::uint32_t recordSize;
+    std::uint64_t recordCount;
+    std::uint64_t heapSize;
+    std::uint64_t sourceSize;
+    std::int64_t sourceMtimeSec;
+    std::int64_t sourceMtimeNsec;
+};
+
+struct SnapshotRecord
+{
+    std::uint64_t offset;
+    std::uint32_t id;
+    std::uint32_t lengths[FIELD_COUNT];
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+static_assert(sizeof(SnapshotRecord) == 48, "snapshot records must stay 48 bytes");
+
+class ContactSnapshot
+{
+    public:
+        static const std::uint32_t VERSION = 1;
+        static const std::uint32_t ENDIAN_MARK = 0x01020304;
+
+        ContactSnapshot() : data_(nullptr), size_(0), records_(nullptr), heap_(nullptr), recordCount_(0), heapSize_(0)
+        {
+
+        }
+
+        ContactSnapshot(const ContactSnapshot&) = delete;
+        ContactSnapshot& operator=(const ContactSnapshot&) = delete;
+
+        ~ContactSnapshot()
+        {
+            Close();
+        }
+
+        // Maps the snapshot if it is well formed and matches the given source file
+        bool Open(const std::string& fileName, const std::string& sourceName)
+        {
+            Close();
+
+            struct stat source;
+            if (stat(sourceName.c_str(), &source) != 0)
+            {
+                return false;
+            }
+
+            int fd = open(fileName.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            struct stat info;
+            if (fstat(fd, &info) != 0 || static_cast<std::uint64_t>(info.st_size) < sizeof(SnapshotHeader))
+            {
+                close(fd);
+                return false;
+            }
+
+            void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+            {
+                return false;
+            }
+            data_ = static_cast<const char*>(data);
+            size_ = static_cast<std::uint64_t>(info.st_size);
+
+            if (!Validate(source))
+            {
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        void Close()
+        {
+            if (data_)
+            {
+                munmap(const_cast<char*>(data_), size_);
+            }
+            data_ = nullptr;
+            size_ = 0;
+            records_ = nullptr;
+            heap_ = nullptr;
+            recordCount_ = 0;
+            heapSize_ = 0;
+        }
+
+        size_t Size() const
+        {
+            return static_cast<size_t>(recordCount_);
+        }
+
+        std::uint32_t GetId(size_t row) const
+        {
+            return records_[row].id;
+        }
+
+        const SnapshotRecord& GetRecord(size_t row) const
+        {
+            return records_[row];
+        }
+
+        // First byte of the fields of a record, they follow each other in field order
+        const char* GetRecordData(size_t row) const
+        {
+            return heap_ + records_[row].offset;
+        }
+
+        std::string_view GetField(size_t row, ContactField field) const
+        {
+            const SnapshotRecord& record = records_[row];
+            std::uint64_t offset = record.offset;
+            for (int i = 0; i < field; i++)
+            {
+                offset += record.lengths[i];
+            }
+            return std::string_view(heap_ + offset, record.lengths[field]);
+        }
+
+        // Writes a snapshot describing the given source file
+        static bool Write(const std::string& fileName, const std::string& sourceName, const std::vector<std::uint32_t>& ids, const std::vector<std::string>& fields)
+        {
+            struct stat source;
+            if (stat(sourceName.c_str(), &source) != 0)
+            {
+                return false;
+            }
+
+            SnapshotHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+            header.version = VERSION;
+            header.byteOrder = ENDIAN_MARK;
+            header.fieldCount = FIELD_COUNT;
+            header.recordSize = sizeof(SnapshotRecord);
+            header.recordCount = ids.size();
+            header.sourceSize = static_cast<std::uint64_t>(source.st_size);
+            header.sourceMtimeSec = source.st_mtim.tv_sec;
+            header.sourceMtimeNsec = source.st_mtim.tv_nsec;
+
+            std::vector<SnapshotRecord> records(ids.size());
+            std::uint64_t heapSize = 0;
+            for (size_t row = 0; row < ids.size(); row++)
+            {
+                SnapshotRecord& record = records[row];
+                std::memset(&record, 0, sizeof(record));
+                record.id = ids[row];
+                record.offset = heapSize;
+                for (int field = 0; field < FIELD_COUNT; field++)
+                {
+                    record.lengths[field] = static_cast<std::uint32_t>(fields[row * FIELD_COUNT + field].size());
+                    heapSize += record.lengths[field];
+                }
+            }
+            header.heapSize = heapSize;
+
+            // Written aside and renamed so a reader never maps a half written file
+            AtomicFileWriter outputFile(fileName);
+            outputFile.Write(reinterpret_cast<const char*>(&header), sizeof(header));
+            outputFile.Write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(SnapshotRecord));
+            for (const std::string& field : fields)
+            {
+                outputFile.Write(field);
+            }
+            return outputFile.Commit();
+        }
+
+    private:
+        static constexpr const char* MAGIC = "TADRSNAP";
+
+        const char* data_;
+        std::uint64_t size_;
+        const SnapshotRecord* records_;
+        const char* heap_;
+        std::uint64_t recordCount_;
+        std::uint64_t heapSize_;
+
+        bool Validate(const struct stat& source)
+        {
+            SnapshotHeader header;
+            std::memcpy(&header, data_, sizeof(header));
+            if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION || header.byteOrder != ENDIAN_MARK ||
+                header.fieldCount != FIELD_COUNT || header.recordSize != sizeof(SnapshotRecord))
+            {
+                return false;
+            }
+
+            if (header.sourceSize != static_cast<std::uint64_t>(source.st_size) || header.sourceMtimeSec != source.st_mtim.tv_sec || header.sourceMtimeNsec != source.st_mtim.tv_nsec)
+            {
+                return false;
+            }
+
+            std::uint64_t available = size_ - sizeof(SnapshotHeader);
+            if (header.recordCount > available / sizeof(SnapshotRecord) || header.heapSize != available - header.recordCount * sizeof(SnapshotRecord))
+            {
+                return false;
+            }
+
+            records_ = reinterpret_cast<const SnapshotRecord*>(data_ + sizeof(SnapshotHeader));
+            heap_ = data_ + sizeof(SnapshotHeader) + header.recordCount * sizeof(SnapshotRecord);
+            recordCount_ = header.recordCount;
+            heapSize_ = header.heapSize;
+
+            // Every record must stay inside the heap
+            for (std::uint64_t row = 0; row < recordCount_; row++)
+            {
+                std::uint64_t end = records_[row].offset;
+                for (int field = 0; field < FIELD_COUNT; field++)
+                {
+                    end += records_[row].lengths[field];
+                }
+                if (records_[row].offset > heapSize_ || end > heapSize_)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+};
+
+#endif // CONTACTSNAPSHOT_H
@@ -0,0 +1,379 @@
+#ifndef CONTACTSTORE_H
+#define CONTACTSTORE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <new>
+#include <utility>
+#include "contactarena.h"
+#include "contactnode.h"
+#include "phoneindex.h"
+#include "companytable.h"
+#include "contactevents.h"
+#include "reminderwheel.h"
+
+// Owns every loaded contact and keeps them in display order, sorted by the
+// cached full-name key of each contact. Views read rows straight from here
+// instead of copying them into widgets, and a new or renamed contact finds its
+// row with a binary search instead of a full re-sort.
+// Nodes come from a pool and their fields from the store's arena, so loading
+// a large agenda does not cost nine heap allocations per contact.
+// Stored contacts are also indexed by normalized phone number and by the
+// start time of their events, which also arm their reminders, and those with
+// a valid company RIF share one entry of the arena's company table, which
+// lists the stored contacts of each company.
+class ContactStore
+{
+    public:
+        ContactStore() : reminders_(wxDateTime::GetTimeNow())
+        {
+
+        }
+
+        ContactStore(const ContactStore&) = delete;
+        ContactStore& operator=(const ContactStore&) = delete;
+
+        ~ContactStore()
+        {
+            Clear();
+        }
+
+        // Drops every contact along with the arena, snapshots and buffers backing them
+        void Clear()
+        {
+            RemoveAll();
+            arena_.GetCompanies().Clear();
+            arena_.DetachChunks();
+            arena_.ReleaseAdopted();
+        }
+
+        // Creates a contact in this store's arena; it is stored once passed to
+        // Add() or Assign(). A valid RIF puts the company in the company table.
+        ContactNode* CreateContact(const std::string& firstName, const std::string& lastName, const std::string& phoneNumber, const std::string& address, const std::string& companyName, const std::string& companyPhone, const std::string& companyRif, const std::string& newEvent)
+        {
+            ContactNode* node = AllocateNode();
+            std::string rif;
+            if (!NormalizeRif(companyRif, rif))
+            {
+                return new (node) ContactNode(&arena_, firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent);
+            }
+
+            ContactNode* contact = new (node) ContactNode(&arena_, firstName, lastName, phoneNumber, address, "", "", "", newEvent);
+            contact->setCompanyId(arena_.GetCompanies().Intern(rif, companyName, companyPhone));
+            return contact;
+        }
+
+        // Creates a contact reading its fields in place from a snapshot adopted with AdoptSnapshot()
+        ContactNode* CreateContact(const ContactSnapshot& snapshot, size_t row)
+        {
+            ContactNode* node = AllocateNode();
+            return LinkCompany(new (node) ContactNode(&arena_, snapshot.GetRecordData(row), snapshot.GetRecord(row).lengths, snapshot.GetId(row)));
+        }
+
+        // Creates a contact reading its fields in place from a buffer adopted with AdoptBuffer()
+        ContactNode* CreateContact(const char* data, const std::uint32_t* lengths, std::uint32_t id)
+        {
+            ContactNode* node = AllocateNode();
+            return LinkCompany(new (node) ContactNode(&arena_, data, lengths, id));
+        }
+
+        // Returns a contact that is not stored, or no longer is, to the pool
+        void DestroyContact(ContactNode* contact)
+        {
+            contact->release();
+            contact->~ContactNode();
+            freeNodes_.push_back(contact);
+        }
+
+        // Keeps a mapped snapshot alive for as long as contacts may read from it
+        void AdoptSnapshot(const std::shared_ptr<const ContactSnapshot>& snapshot)
+        {
+            arena_.AdoptSnapshot(snapshot);
+        }
+
+        // Keeps a loaded file buffer alive for as long as contacts may read from it
+        void AdoptBuffer(std::unique_ptr<char[]> buffer)
+        {
+            arena_.AdoptBuffer(std::move(buffer));
+        }
+
+        // Replaces the stored contacts, taking ownership of them
+        void Assign(std::vector<ContactNode*>& contacts)
+        {
+            // The new contacts may already live in the arena, keep it
+            RemoveAll();
+
+            contacts_.swap(contacts);
+            contacts.clear();
+            std::stable_sort(contacts_.begin(), contacts_.end(), CompareContacts);
+
+            phoneIndex_.Reserve(contacts_.size());
+            for (ContactNode* contact : contacts_)
+            {
+                IndexContact(contact);
+            }
+        }
+
+        // Takes ownership of the contact and returns the row it was inserted at
+        size_t Add(ContactNode* contact)
+        {
+            size_t row = Insert(contact);
+            IndexContact(contact);
+            CompactArenaIfNeeded();
+            return row;
+        }
+
+        // Takes ownership of many new contacts at once, merging them into
+        // place instead of inserting them one by one
+        void AddAll(const std::vector<ContactNode*>& contacts)
+        {
+            size_t middle = contacts_.size();
+            contacts_.insert(contacts_.end(), contacts.begin(), contacts.end());
+            std::stable_sort(contacts_.begin() + middle, contacts_.end(), CompareContacts);
+            std::inplace_merge(contacts_.begin(), contacts_.begin() + middle, contacts_.end(), CompareContacts);
+            for (ContactNode* contact : contacts)
+            {
+                IndexContact(contact);
+            }
+            CompactArenaIfNeeded();
+        }
+
+        // Called after a stored contact was edited: reindexes its phone number,
+        // events and company and moves it to its new row if the name changed,
+        // returning that row
+        size_t Reposition(size_t row)
+        {
+            CompactArenaIfNeeded();
+            ContactNode* contact = contacts_[row];
+            phoneIndex_.UpdateContact(contact);
+            arena_.GetCompanies().SetMember(contact, contact->getCompanyId());
+
+            // The reminders are updated in place, so those that fired stay fired
+            eventIndex_.RemoveContact(contact);
+            IndexEvents(contact);
+            bool afterPrevious = row == 0 || !CompareContacts(contact, contacts_[row - 1]);
+            bool beforeNext = row + 1 == contacts_.size() || !CompareContacts(contacts_[row + 1], contact);
+            if (afterPrevious && beforeNext)
+            {
+                return row;
+            }
+
+            contacts_.erase(contacts_.begin() + row);
+            return Insert(contact);
+        }
+
+        // Deletes the contact shown at the given row
+        void Remove(size_t row)
+        {
+            phoneIndex_.RemoveContact(contacts_[row]);
+            UnindexEvents(contacts_[row]);
+            arena_.GetCompanies().SetMember(contacts_[row], CompanyTable::NO_COMPANY);
+            DestroyContact(contacts_[row]);
+            contacts_.erase(contacts_.begin() + row);
+            CompactArenaIfNeeded();
+        }
+
+        ContactNode* GetContact(size_t row) const
+        {
+            return contacts_[row];
+        }
+
+        // Returns the row of a contact or -1 if it is not stored
+        int FindRow(const ContactNode* contact) const
+        {
+            // Only contacts sharing the same name need to be compared
+            auto range = std::equal_range(contacts_.begin(), contacts_.end(), contact, CompareContacts);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (*it == contact)
+                {
+                    return static_cast<int>(it - contacts_.begin());
+                }
+            }
+            return -1;
+        }
+
+        // Stored contacts with the same phone number once normalized
+        std::vector<ContactNode*> FindByPhone(std::string_view phoneNumber) const
+        {
+            return phoneIndex_.Find(phoneNumber);
+        }
+
+        // A stored contact other than except using the phone number, or null
+        ContactNode* FindPhoneDuplicate(std::string_view phoneNumber, const ContactNode* except = nullptr) const
+        {
+            return phoneIndex_.FindDuplicate(phoneNumber, except);
+        }
+
+        // Sets the company of a contact, stored or not. With a valid RIF the
+        // contact points at the company in the table, whose name and phone
+        // become the given ones; returns true if that changed them for its
+        // other contacts too. Otherwise the fields are kept in the contact
+        // itself. A stored contact moves to the company's contact list once
+        // Reposition() is called.
+        bool SetCompany(ContactNode* contact, const std::string& companyName, const std::string& companyPhone, const std::string& companyRif)
+        {
+            CompanyTable& companies = arena_.GetCompanies();
+            std::string rif;
+            std::uint32_t companyId = NormalizeRif(companyRif, rif) ? companies.Intern(rif, companyName, companyPhone) : CompanyTable::NO_COMPANY;
+            contact->setCompanyId(companyId);
+            if (companyId == CompanyTable::NO_COMPANY)
+            {
+                contact->setCompanyFields(companyName, companyPhone, companyRif);
+                return false;
+            }
+            return companies.Update(companyId, companyName, companyPhone);
+        }
+
+        // Gives the company with this RIF the non-empty name and phone given;
+        // returns false if it is not in the table or nothing changed
+        bool UpdateCompany(std::string_view companyRif, std::string_view companyName, std::string_view companyPhone)
+        {
+            CompanyTable& companies = arena_.GetCompanies();
+            std::uint32_t companyId = companies.Find(companyRif);
+            return companyId != CompanyTable::NO_COMPANY && companies.Update(companyId, companyName, companyPhone);
+        }
+
+        // Events of the stored contacts by start time
+        const EventIndex& GetEvents() const
+        {
+            return eventIndex_;
+        }
+
+        // Moves the reminder clock to now, in seconds since the epoch, and
+        // appends the reminders that fell due
+        void AdvanceReminders(std::int64_t now, std::vector<EventEntry>& due)
+        {
+            reminders_.Advance(now, due);
+        }
+
+        // Companies by RIF, each with the stored contacts working at it
+        const CompanyTable& GetCompanies() const
+        {
+            return arena_.GetCompanies();
+        }
+
+        size_t Size() const
+        {
+            return contacts_.size();
+        }
+
+        const std::vector<ContactNode*>& GetContacts() const
+        {
+            return contacts_;
+        }
+
+    private:
+        // Garbage the arena may hold before live fields are copied out of it
+        static const size_t COMPACT_GARBAGE_BYTES = 8 << 20;
+
+        // Raw node storage; a deque never moves the nodes it already holds
+        struct NodeSlot
+        {
+            alignas(ContactNode) unsigned char bytes[sizeof(ContactNode)];
+        };
+
+        ContactArena arena_;
+        std::deque<NodeSlot> nodeSlots_;
+        std::vector<ContactNode*> freeNodes_;
+        std::vector<ContactNode*> contacts_;
+        PhoneIndex phoneIndex_;
+        EventIndex eventIndex_;
+        ReminderWheel reminders_;
+
+        static bool CompareContacts(const ContactNode* a, const ContactNode* b)
+        {
+            return a->getSortKey() < b->getSortKey();
+        }
+
+        void RemoveAll()
+        {
+            for (ContactNode* contact : contacts_)
+            {
+                DestroyContact(contact);
+            }
+            contacts_.clear();
+            phoneIndex_.Clear();
+            eventIndex_.Clear();
+            reminders_.Clear();
+            arena_.GetCompanies().ClearMembers();
+        }
+
+        void IndexContact(ContactNode* contact)
+        {
+            phoneIndex_.AddContact(contact);
+            IndexEvents(contact);
+            arena_.GetCompanies().SetMember(contact, contact->getCompanyId());
+        }
+
+        // Parses the event field once for both the event index and the
+        // reminders; a field without events leaves the contact none
+        void IndexEvents(ContactNode* contact)
+        {
+            std::vector<ContactEvent> events;
+            ParseContactEvents(contact->getNewEvent(), events);
+            eventIndex_.AddContact(contact, events);
+            reminders_.UpdateContact(contact, events);
+        }
+
+        void UnindexEvents(ContactNode* contact)
+        {
+            eventIndex_.RemoveContact(contact);
+            reminders_.RemoveContact(contact);
+        }
+
+        // Moves the company of a contact read in place into the company table
+        // if its RIF is valid
+        ContactNode* LinkCompany(ContactNode* contact)
+        {
+            std::string rif;
+            if (NormalizeRif(contact->getCompanyRif(), rif))
+            {
+                contact->setCompanyId(arena_.GetCompanies().Intern(rif, contact->getCompanyName(), contact->getCompanyPhone()));
+            }
+            return contact;
+        }
+
+        ContactNode* AllocateNode()
+        {
+            if (!freeNodes_.empty())
+            {
+                ContactNode* node = freeNodes_.back();
+                freeNodes_.pop_back();
+                return node;
+            }
+            nodeSlots_.emplace_back();
+            return reinterpret_cast<ContactNode*>(nodeSlots_.back().bytes);
+        }
+
+        // Copies the live fields into fresh chunks once edits and deletes left
+        // more garbage than live data. Only stored contacts survive, so no
+        // unstored node may hold arena bytes when this runs.
+        void CompactArenaIfNeeded()
+        {
+            if (arena_.GetGarbageBytes() < COMPACT_GARBAGE_BYTES || arena_.GetGarbageBytes() < arena_.GetLiveBytes())
+            {
+                return;
+            }
+
+            std::vector<std::unique_ptr<char[]>> oldChunks = arena_.DetachChunks();
+            for (ContactNode* contact : contacts_)
+            {
+                contact->relocate();
+            }
+        }
+
+        // Places the contact after any contact with the same name
+        size_t Insert(ContactNode* contact)
+        {
+            size_t row = std::upper_bound(contacts_.begin(), contacts_.end(), contact, CompareContacts) - contacts_.begin();
+            contacts_.insert(contacts_.begin() + row, contact);
+            return row;
+        }
+};
+
+#endif // CONTACTSTORE_H
@@ -0,0 +1,498 @@
+#ifndef CONTACTVCARD_H
+#define CONTACTVCARD_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "atomicfile.h"
+#include "backgroundjob.h"
+#include "contactnode.h"
+
+// Property holding the company RIF, which vCard has no standard property for
+const char VCARD_RIF_PROPERTY[] = "X-COMPANY-RIF";
+
+inline char FoldAsciiUpper(char c)
+{
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+inline bool EqualsIgnoringCase(std::string_view text, std::string_view upper)
+{
+    if (text.size() != upper.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (FoldAsciiUpper(text[i]) != upper[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True when fileName ends in .vcf or .vcard, in any case
+inline bool IsVcardFileName(const std::string& fileName)
+{
+    std::string_view name(fileName);
+    return (name.size() >= 4 && EqualsIgnoringCase(name.substr(name.size() - 4), ".VCF")) || (name.size() >= 6 && EqualsIgnoringCase(name.substr(name.size() - 6), ".VCARD"));
+}
+
+// Appends text escaped as a vCard text value
+inline void AppendVcardText(std::string& line, std::string_view text)
+{
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '\\':
+                line += "\\\\";
+                break;
+            case ',':
+                line += "\\,";
+                break;
+            case ';':
+                line += "\\;";
+                break;
+            case '\n':
+                line += "\\n";
+                break;
+            case '\r':
+                break;
+            default:
+                line += c;
+        }
+    }
+}
+
+// Unescapes a vCard value. A structured value is split into its components
+// on unescaped semicolons, any other comes back as one component.
+inline void SplitVcardValue(std::string_view value, bool structured, std::vector<std::string>& components)
+{
+    components.assign(1, std::string());
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        char c = value[i];
+        if (c == '\\' && i + 1 < value.size())
+        {
+            char escaped = value[++i];
+            components.back() += (escaped == 'n' || escaped == 'N') ? '\n' : escaped;
+        }
+        else if (c == ';' && structured)
+        {
+            components.emplace_back();
+        }
+        else
+        {
+            components.back() += c;
+        }
+    }
+}
+
+// Writes one content line, folded every 75 octets as RFC 6350 asks without
+// splitting a UTF-8 character
+inline void WriteVcardLine(AtomicFileWriter& output, std::string_view line)
+{
+    const size_t MAX_LINE_OCTETS = 75;
+
+    size_t limit = MAX_LINE_OCTETS;
+    while (line.size() > limit)
+    {
+        size_t cut = limit;
+        while (cut > 1 && (static_cast<unsigned char>(line[cut]) & 0xC0) == 0x80)
+        {
+            cut--;
+        }
+        output.Write(line.substr(0, cut));
+        output.Write("\r\n ", 3);
+        line.remove_prefix(cut);
+
+        // The space starting a continuation line counts against it
+        limit = MAX_LINE_OCTETS - 1;
+    }
+    output.Write(line);
+    output.Write("\r\n", 2);
+}
+
+// Writes the contacts to fileName as vCard 3.0, one card per contact in the
+// given order. Like the CSV export it streams through the writer's buffer and
+// only replaces fileName once the whole file is on disk; a cancelled export
+// returns false leaving fileName as it was.
+inline bool ExportContactsVcard(const std::vector<ContactNode*>& contacts, const std::string& fileName, JobProgress* progress = nullptr)
+{
+    // Cards written between two progress updates and cancel checks
+    const size_t PROGRESS_STEP = 4096;
+
+    if (progress)
+    {
+        progress->total = contacts.size();
+    }
+
+    AtomicFileWriter output(fileName);
+    std::string line;
+    auto writeProperty = [&](std::string_view name, std::string_view value)
+    {
+        if (!value.empty())
+        {
+            line.assign(name.data(), name.size());
+            line += ':';
+            AppendVcardText(line, value);
+            WriteVcardLine(output, line);
+        }
+    };
+
+    for (size_t row = 0; row < contacts.size(); row++)
+    {
+        if (progress && row % PROGRESS_STEP == 0)
+        {
+            if (progress->IsCancelled())
+            {
+                return false;
+            }
+            progress->done = row;
+        }
+
+        const ContactNode* contact = contacts[row];
+        WriteVcardLine(output, "BEGIN:VCARD");
+        WriteVcardLine(output, "VERSION:3.0");
+
+        line = "N:";
+        AppendVcardText(line, contact->getLastName());
+        line += ';';
+        AppendVcardText(line, contact->getFirstName());
+        line += ";;;";
+        WriteVcardLine(output, line);
+
+        // FN is required even when empty
+        line = "FN:";
+        AppendVcardText(line, contact->getFullName());
+        WriteVcardLine(output, line);
+
+        writeProperty("TEL;TYPE=CELL", contact->getPhoneNumber());
+        if (!contact->getAddress().empty())
+        {
+            // The address is free text, it goes in the street component
+            line = "ADR;TYPE=HOME:;;";
+            AppendVcardText(line, contact->getAddress());
+            line += ";;;;";
+            WriteVcardLine(output, line);
+        }
+        writeProperty("ORG", contact->getCompanyName());
+        writeProperty("TEL;TYPE=WORK", contact->getCompanyPhone());
+        writeProperty(VCARD_RIF_PROPERTY, contact->getCompanyRif());
+        writeProperty("NOTE", contact->getNewEvent());
+        WriteVcardLine(output, "END:VCARD");
+    }
+
+    if (progress)
+    {
+        if (progress->IsCancelled())
+        {
+            return false;
+        }
+        progress->done = contacts.size();
+    }
+    return output.Commit();
+}
+
+// Reads vCard 3.0 and 4.0 cards one at a time, as the eight contact fields,
+// so memory use depends on the largest card rather than on the file. Folded
+// lines are unfolded; the ones of properties without a contact field, such
+// as photos, are skipped without being kept. Offers the same interface as
+// CsvReader so ContactImporter can read either.
+class VcardReader
+{
+    public:
+        explicit VcardReader(const std::string& fileName) : file_(fileName, std::ios::binary), bytesRead_(0), line_(0), propertyLine_(0), recordLine_(0), malformed_(false)
+        {
+
+        }
+
+        bool IsOpen() const
+        {
+            return file_.is_open();
+        }
+
+        // Reads the next card into fields; returns false at the end of the file
+        bool ReadRecord(std::vector<std::string>& fields)
+        {
+            fields.assign(FIELD_COUNT, std::string());
+            malformed_ = false;
+
+            bool started = false;
+            std::string name;
+            std::string parameters;
+            std::string value;
+            while (ReadProperty(name, parameters, value))
+            {
+                if (!started)
+                {
+                    if (name == "BEGIN" && EqualsIgnoringCase(value, "VCARD"))
+                    {
+                        started = true;
+                        recordLine_ = propertyLine_;
+                        fullName_.clear();
+                    }
+                    continue;
+                }
+
+                if (name == "END" && EqualsIgnoringCase(value, "VCARD"))
+                {
+                    FinishRecord(fields);
+                    return true;
+                }
+                ReadField(name, parameters, value, fields);
+            }
+
+            if (!started)
+            {
+                return false;
+            }
+
+            // The file ended inside the card
+            malformed_ = true;
+            FinishRecord(fields);
+            return true;
+        }
+
+        // Line the last card started on
+        size_t GetRecordLine() const
+        {
+            return recordLine_;
+        }
+
+        // True when the last card had no END line
+        bool IsMalformed() const
+        {
+            return malformed_;
+        }
+
+        std::uint64_t GetBytesRead() const
+        {
+            return bytesRead_;
+        }
+
+    private:
+        std::ifstream file_;
+        std::string physicalLine_;
+        std::string fullName_;
+        std::vector<std::string> components_;
+        std::uint64_t bytesRead_;
+        size_t line_;
+        size_t propertyLine_;
+        size_t recordLine_;
+        bool malformed_;
+
+        bool ReadPhysicalLine(std::string& line)
+        {
+            if (!std::getline(file_, line))
+            {
+                return false;
+            }
+            bytesRead_ += line.size() + 1;
+            line_++;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line_ == 1 && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            {
+                line.erase(0, 3);
+            }
+            return true;
+        }
+
+        static bool IsMappedProperty(std::string_view name)
+        {
+            static const char* const MAPPED[] = {"BEGIN", "END", "N", "FN", "TEL", "ADR", "ORG", "NOTE", VCARD_RIF_PROPERTY};
+            for (const char* mapped : MAPPED)
+            {
+                if (EqualsIgnoringCase(name, mapped))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Reads the next unfolded content line and splits it into its upper
+        // cased name, without group, its parameters and its raw value
+        bool ReadProperty(std::string& name, std::string& parameters, std::string& value)
+        {
+            std::string& line = physicalLine_;
+            do
+            {
+                if (!ReadPhysicalLine(line))
+                {
+                    return false;
+                }
+            }
+            while (line.empty());
+            propertyLine_ = line_;
+
+            size_t nameEnd = line.find_first_of(";:");
+            size_t groupEnd = line.find('.');
+            size_t nameStart = (groupEnd != std::string::npos && groupEnd < nameEnd) ? groupEnd + 1 : 0;
+            name.assign(line, nameStart, nameEnd == std::string::npos ? std::string::npos : nameEnd - nameStart);
+            bool mapped = IsMappedProperty(name);
+
+            // Continuation lines start with a space or a tab
+            std::string continuation;
+            while (file_.peek() == ' ' || file_.peek() == '\t')
+            {
+                ReadPhysicalLine(continuation);
+                if (mapped)
+                {
+                    line.append(continuation, 1, std::string::npos);
+                }
+            }
+
+            if (!mapped)
+            {
+                name.clear();
+                parameters.clear();
+                value.clear();
+                return true;
+            }
+
+            for (char& c : name)
+            {
+                c = FoldAsciiUpper(c);
+            }
+
+            // Parameter values may be quoted and hold colons
+            size_t colon = nameEnd;
+            bool quoted = false;
+            for (; colon < line.size(); colon++)
+            {
+                if (line[colon] == '"')
+                {
+                    quoted = !quoted;
+                }
+                else if (line[colon] == ':' && !quoted)
+                {
+                    break;
+                }
+            }
+            if (colon >= line.size())
+            {
+                parameters.clear();
+                value.clear();
+                return true;
+            }
+            parameters.assign(line, nameEnd, colon - nameEnd);
+            value.assign(line, colon + 1, std::string::npos);
+            return true;
+        }
+
+        // True when a TYPE parameter, or a bare 2.1 style one, says work
+        static bool IsWorkType(const std::string& parameters)
+        {
+            size_t start = 0;
+            while (start < parameters.size())
+            {
+                size_t end = parameters.find_first_of(";,=\"", start);
+                if (end == std::string::npos)
+                {
+                    end = parameters.size();
+                }
+                if (EqualsIgnoringCase(std::string_view(parameters).substr(start, end - start), "WORK"))
+                {
+                    return true;
+                }
+                start = end + 1;
+            }
+            return false;
+        }
+
+        static void AssignOnce(std::string& field, std::string& value)
+        {
+            if (field.empty())
+            {
+                field = std::move(value);
+            }
+        }
+
+        void ReadField(const std::string& name, const std::string& parameters, const std::string& value, std::vector<std::string>& fields)
+        {
+            if (name == "N")
+            {
+                SplitVcardValue(value, true, components_);
+                components_.resize(2);
+                fields[FIELD_LAST_NAME] = std::move(components_[0]);
+                fields[FIELD_FIRST_NAME] = std::move(components_[1]);
+            }
+            else if (name == "FN")
+            {
+                SplitVcardValue(value, false, components_);
+                fullName_ = std::move(components_[0]);
+            }
+            else if (name == "TEL")
+            {
+                SplitVcardValue(value, false, components_);
+                std::string& number = components_[0];
+
+                // vCard 4.0 may give the number as a tel: URI
+                if (number.size() >= 4 && EqualsIgnoringCase(std::string_view(number).substr(0, 4), "TEL:"))
+                {
+                    number.erase(0, 4);
+                }
+                AssignOnce(fields[IsWorkType(parameters) ? FIELD_COMPANY_PHONE : FIELD_PHONE_NUMBER], number);
+            }
+            else if (name == "ADR")
+            {
+                SplitVcardValue(value, true, components_);
+                std::string address;
+                for (const std::string& component : components_)
+                {
+                    if (!component.empty())
+                    {
+                        if (!address.empty())
+                        {
+                            address += ' ';
+                        }
+                        address += component;
+                    }
+                }
+                AssignOnce(fields[FIELD_ADDRESS], address);
+            }
+            else if (name == "ORG")
+            {
+                SplitVcardValue(value, true, components_);
+                AssignOnce(fields[FIELD_COMPANY_NAME], components_[0]);
+            }
+            else if (name == "NOTE")
+            {
+                SplitVcardValue(value, false, components_);
+                AssignOnce(fields[FIELD_NEW_EVENT], components_[0]);
+            }
+            else if (name == VCARD_RIF_PROPERTY)
+            {
+                SplitVcardValue(value, false, components_);
+                AssignOnce(fields[FIELD_COMPANY_RIF], components_[0]);
+            }
+        }
+
+        // Cards with only a formatted name are split at its last space
+        void FinishRecord(std::vector<std::string>& fields)
+        {
+            if (fields[FIELD_FIRST_NAME].empty() && fields[FIELD_LAST_NAME].empty() && !fullName_.empty())
+            {
+                size_t space = fullName_.find_last_of(' ');
+                if (space == std::string::npos)
+                {
+                    fields[FIELD_FIRST_NAME] = fullName_;
+                }
+                else
+                {
+                    fields[FIELD_FIRST_NAME] = fullName_.substr(0, space);
+                    fields[FIELD_LAST_NAME] = fullName_.substr(space + 1);
+                }
+            }
+        }
+};
+
+#endif // CONTACTVCARD_H
@@ -0,0 +1,308 @@
+#ifndef CONTACTWRITER_H
+#define CONTACTWRITER_H
+
+#include <wx/thread.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include "atomicfile.h"
+#include "contactsnapshot.h"
+#include "delimiterscanner.h"
+
+// Splits a contacts.txt line into its eight fields plus the id field
+inline void SplitContactRecord(const std::string& line, std::vector<std::string>& fields)
+{
+    fields.assign(FIELD_COUNT + 1, std::string());
+    const char* end = line.data() + line.size();
+    DelimiterScanner scanner(line.data(), end, ',');
+    const char* field = line.data();
+    for (std::string& value : fields)
+    {
+        const char* delimiter = scanner.Next();
+        value.assign(field, delimiter);
+        if (delimiter == end)
+        {
+            break;
+        }
+        field = delimiter + 1;
+    }
+}
+
+// Record lines of the contacts to write, without their ids, copied into one
+// buffer in store order
+struct ContactRecords
+{
+    struct Entry
+    {
+        std::uint32_t id;
+        size_t offset;
+        size_t length;
+    };
+
+    std::string text;
+    std::vector<Entry> entries;
+};
+
+// contacts.txt lines of the records in id order, each ending in its id field
+inline std::vector<std::string> FormatContactRecords(ContactRecords& records)
+{
+    std::sort(records.entries.begin(), records.entries.end(), [](const ContactRecords::Entry& a, const ContactRecords::Entry& b)
+    {
+        return a.id < b.id;
+    });
+
+    std::vector<std::string> lines(records.entries.size());
+    for (size_t i = 0; i < records.entries.size(); i++)
+    {
+        const ContactRecords::Entry& entry = records.entries[i];
+        std::string id = std::to_string(entry.id);
+        lines[i].reserve(entry.length + 1 + id.size());
+        lines[i].assign(records.text, entry.offset, entry.length);
+        lines[i] += ',';
+        lines[i] += id;
+    }
+    return lines;
+}
+
+// Replaces contacts.txt with the given lines, synced to disk before the
+// rename, then writes the matching binary snapshot. Returns false if
+// contacts.txt was not replaced.
+inline bool WriteContactFiles(const std::vector<std::string>& lines, const std::string& fileName, const std::string& snapshotName)
+{
+    AtomicFileWriter outputFile(fileName);
+    for (const std::string& line : lines)
+    {
+        outputFile.Write(line);
+        outputFile.Write("\n", 1);
+    }
+    if (!outputFile.Commit())
+    {
+        return false;
+    }
+
+    // A failed snapshot is only a slower next start, its header no longer matches
+    std::vector<std::uint32_t> ids;
+    std::vector<std::string> fields;
+    std::vector<std::string> record;
+    ids.reserve(lines.size());
+    fields.reserve(lines.size() * FIELD_COUNT);
+    for (const std::string& line : lines)
+    {
+        SplitContactRecord(line, record);
+        ids.push_back(static_cast<std::uint32_t>(std::strtoul(record[FIELD_COUNT].c_str(), nullptr, 10)));
+        for (int field = 0; field < FIELD_COUNT; field++)
+        {
+            fields.push_back(std::move(record[field]));
+        }
+    }
+    ContactSnapshot::Write(snapshotName, fileName, ids, fields);
+    return true;
+}
+
+// Performs every write to contacts.txt, its snapshot and its journal on one
+// background thread, in the order the GUI thread queued them. Journal records
+// queued while the thread is busy are merged into one write and one sync, so
+// a burst of edits costs a single flush. The GUI thread only queues and
+// returns; Flush() waits for the queue when a file must be current.
+class ContactWriter : public wxThread
+{
+    public:
+        ContactWriter(const std::string& fileName, const std::string& journalName, const std::string& oldJournalName, const std::string& snapshotName) : wxThread(wxTHREAD_JOINABLE), fileName_(fileName), journalName_(journalName), oldJournalName_(oldJournalName), snapshotName_(snapshotName), journalFd_(-1), condition_(mutex_), idle_(mutex_), busy_(false), running_(false), stopping_(false)
+        {
+
+        }
+
+        ~ContactWriter()
+        {
+            CloseJournal();
+        }
+
+        // Starts the thread; if it cannot run, every job is done by the caller instead
+        void Start()
+        {
+            running_ = Run() == wxTHREAD_NO_ERROR;
+        }
+
+        // Appends records, each ending in a newline, to the journal
+        void Append(const std::string& records)
+        {
+            wxMutexLocker lock(mutex_);
+            if (running_ && !jobs_.empty() && jobs_.back().kind == JOB_APPEND)
+            {
+                jobs_.back().records += records;
+                return;
+            }
+            Job job;
+            job.kind = JOB_APPEND;
+            job.records = records;
+            Enqueue(job);
+        }
+
+        // Replaces contacts.txt and its snapshot with the given records, then
+        // empties the journals they already contain. Sorting and formatting
+        // the lines is left to the thread.
+        void WriteAll(ContactRecords& records)
+        {
+            wxMutexLocker lock(mutex_);
+            Job job;
+            job.kind = JOB_WRITE_ALL;
+            std::swap(job.contacts, records);
+            Enqueue(job);
+        }
+
+        // Blocks until every queued job is on disk
+        void Flush()
+        {
+            wxMutexLocker lock(mutex_);
+            while (running_ && (busy_ || !jobs_.empty()))
+            {
+                idle_.Wait();
+            }
+        }
+
+        // Finishes the queued jobs and joins the thread
+        void Stop()
+        {
+            {
+                wxMutexLocker lock(mutex_);
+                if (!running_)
+                {
+                    return;
+                }
+                stopping_ = true;
+                condition_.Signal();
+            }
+            Wait();
+            running_ = false;
+        }
+
+    protected:
+        ExitCode Entry() override
+        {
+            while (true)
+            {
+                std::deque<Job> jobs;
+                {
+                    wxMutexLocker lock(mutex_);
+                    while (jobs_.empty() && !stopping_)
+                    {
+                        condition_.Wait();
+                    }
+                    if (jobs_.empty())
+                    {
+                        break;
+                    }
+                    jobs.swap(jobs_);
+                    busy_ = true;
+                }
+
+                for (Job& job : jobs)
+                {
+                    Perform(job);
+                }
+
+                wxMutexLocker lock(mutex_);
+                busy_ = false;
+                if (jobs_.empty())
+                {
+                    idle_.Broadcast();
+                }
+            }
+
+            return static_cast<ExitCode>(0);
+        }
+
+    private:
+        enum JobKind
+        {
+            JOB_APPEND,
+            JOB_WRITE_ALL
+        };
+
+        struct Job
+        {
+            JobKind kind;
+            std::string records;
+            ContactRecords contacts;
+        };
+
+        std::string fileName_;
+        std::string journalName_;
+        std::string oldJournalName_;
+        std::string snapshotName_;
+        int journalFd_;
+        wxMutex mutex_;
+        wxCondition condition_;
+        wxCondition idle_;
+        std::deque<Job> jobs_;
+        bool busy_;
+        bool running_;
+        bool stopping_;
+
+        // Called with mutex_ held
+        void Enqueue(Job& job)
+        {
+            if (!running_)
+            {
+                Perform(job);
+                return;
+            }
+            jobs_.push_back(std::move(job));
+            condition_.Signal();
+        }
+
+        void Perform(Job& job)
+        {
+            switch (job.kind)
+            {
+                case JOB_APPEND:
+                    if (journalFd_ < 0)
+                    {
+                        journalFd_ = open(journalName_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                    }
+                    if (journalFd_ >= 0 && WriteFully(journalFd_, job.records.data(), job.records.size()))
+                    {
+                        fdatasync(journalFd_);
+                    }
+                    break;
+
+                case JOB_WRITE_ALL:
+                    // On failure the old file and the journals still hold every change
+                    if (WriteContactFiles(FormatContactRecords(job.contacts), fileName_, snapshotName_))
+                    {
+                        TruncateJournals();
+                    }
+                    break;
+            }
+        }
+
+        // Replaying is idempotent, so a crash before this only replays records contacts.txt already has
+        void TruncateJournals()
+        {
+            CloseJournal();
+            std::remove(oldJournalName_.c_str());
+            journalFd_ = open(journalName_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+            if (journalFd_ >= 0)
+            {
+                fsync(journalFd_);
+            }
+            SyncDirectoryOf(journalName_);
+        }
+
+        void CloseJournal()
+        {
+            if (journalFd_ >= 0)
+            {
+                close(journalFd_);
+                journalFd_ = -1;
+            }
+        }
+};
+
+#endif // CONTACTWRITER_H
@@ -0,0 +1,167 @@
+#ifndef DELIMITERSCANNER_H
+#define DELIMITERSCANNER_H
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DELIMITER_SCANNER_X86 1
+#endif
+
+// Walks a buffer and returns the position of each delimiter in turn, for up
+// to three delimiter characters (for example ',', '\n' and '"'). Bytes are
+// classified 64 at a time into a bit mask, with AVX2 when the CPU has it,
+// SSE2 otherwise and plain compares as a fallback; every path finds the
+// same positions. The scanner never writes to the buffer, and a byte is
+// classified before Next() returns any delimiter after it, so callers may
+// rewrite the bytes in front of the last returned delimiter.
+class DelimiterScanner
+{
+    public:
+        static const size_t BLOCK_SIZE = 64;
+
+        DelimiterScanner(const char* begin, const char* end, char first, char second, char third) : block_(begin), end_(end), mask_(0), first_(first), second_(second), third_(third)
+        {
+            mask_ = ClassifyBlock();
+        }
+
+        DelimiterScanner(const char* begin, const char* end, char first, char second) : DelimiterScanner(begin, end, first, second, second)
+        {
+
+        }
+
+        DelimiterScanner(const char* begin, const char* end, char delimiter) : DelimiterScanner(begin, end, delimiter, delimiter, delimiter)
+        {
+
+        }
+
+        // Returns the next delimiter, or the end of the buffer once there is none left
+        const char* Next()
+        {
+            while (mask_ == 0)
+            {
+                if (end_ - block_ <= static_cast<std::ptrdiff_t>(BLOCK_SIZE))
+                {
+                    block_ = end_;
+                    return end_;
+                }
+                block_ += BLOCK_SIZE;
+                mask_ = ClassifyBlock();
+            }
+
+            const char* delimiter = block_ + CountTrailingZeros(mask_);
+            mask_ &= mask_ - 1;
+            return delimiter;
+        }
+
+    private:
+        typedef std::uint64_t (*ClassifyFunction)(const char*, char, char, char);
+
+        const char* block_;
+        const char* end_;
+        std::uint64_t mask_;
+        char first_;
+        char second_;
+        char third_;
+
+        // Bit i is set when block_[i] is a delimiter
+        std::uint64_t ClassifyBlock() const
+        {
+            if (end_ - block_ < static_cast<std::ptrdiff_t>(BLOCK_SIZE))
+            {
+                return ClassifyScalar(block_, end_ - block_, first_, second_, third_);
+            }
+
+            static const ClassifyFunction classify = SelectClassifier();
+            return classify(block_, first_, second_, third_);
+        }
+
+        static std::uint64_t ClassifyScalar(const char* data, std::ptrdiff_t size, char first, char second, char third)
+        {
+            std::uint64_t mask = 0;
+            for (std::ptrdiff_t i = 0; i < size; i++)
+            {
+                if (data[i] == first || data[i] == second || data[i] == third)
+                {
+                    mask |= std::uint64_t(1) << i;
+                }
+            }
+            return mask;
+        }
+
+        static std::uint64_t ClassifyBlockScalar(const char* data, char first, char second, char third)
+        {
+            return ClassifyScalar(data, BLOCK_SIZE, first, second, third);
+        }
+
+#if defined(DELIMITER_SCANNER_X86) && defined(__SSE2__)
+        static std::uint64_t ClassifyBlockSse2(const char* data, char first, char second, char third)
+        {
+            const __m128i firstVector = _mm_set1_epi8(first);
+            const __m128i secondVector = _mm_set1_epi8(second);
+            const __m128i thirdVector = _mm_set1_epi8(third);
+
+            std::uint64_t mask = 0;
+            for (size_t offset = 0; offset < BLOCK_SIZE; offset += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+                __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, firstVector), _mm_cmpeq_epi8(bytes, secondVector)), _mm_cmpeq_epi8(bytes, thirdVector));
+                mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(matches))) << offset;
+            }
+            return mask;
+        }
+#endif
+
+#if defined(DELIMITER_SCANNER_X86)
+        __attribute__((target("avx2")))
+        static std::uint64_t ClassifyBlockAvx2(const char* data, char first, char second, char third)
+        {
+            const __m256i firstVector = _mm256_set1_epi8(first);
+            const __m256i secondVector = _mm256_set1_epi8(second);
+            const __m256i thirdVector = _mm256_set1_epi8(third);
+
+            std::uint64_t mask = 0;
+            for (size_t offset = 0; offset < BLOCK_SIZE; offset += 32)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+                __m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, firstVector), _mm256_cmpeq_epi8(bytes, secondVector)), _mm256_cmpeq_epi8(bytes, thirdVector));
+                mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(matches))) << offset;
+            }
+            return mask;
+        }
+#endif
+
+        // Picked once, on the first block classified
+        static ClassifyFunction SelectClassifier()
+        {
+#if defined(DELIMITER_SCANNER_X86)
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return ClassifyBlockAvx2;
+            }
+#endif
+#if defined(DELIMITER_SCANNER_X86) && defined(__SSE2__)
+            return ClassifyBlockSse2;
+#else
+            return ClassifyBlockScalar;
+#endif
+        }
+
+        static int CountTrailingZeros(std::uint64_t mask)
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(mask);
+#else
+            int count = 0;
+            while ((mask & 1) == 0)
+            {
+                mask >>= 1;
+                count++;
+            }
+            return count;
+#endif
+        }
+};
+
+#endif // DELIMITERSCANNER_H
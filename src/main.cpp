@@ -1,164 +1,561 @@
 #include <wx/wx.h>
 #include <wx/app.h>
 #include <wx/window.h>
-#include <wx/treectrl.h>
+#include <wx/dataview.h>
+#include <wx/progdlg.h>
+#include <wx/appprogress.h>
+#include <wx/textcompleter.h>
+#include <wx/datectrl.h>
+#include <wx/dateevt.h>
+#include <wx/timectrl.h>
+#include <wx/notifmsg.h>
 #include <string>
+#include <string_view>
+#include <iterator>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
-
-class ContactNode 
+#include <functional>
+#include <memory>
+#include "contactnode.h"
+#include "contactstore.h"
+#include "contactevents.h"
+#include "backgroundjob.h"
+#include "contactjournal.h"
+#include "searchindex.h"
+#include "searchworker.h"
+#include "completiontrie.h"
+#include "contactcsv.h"
+#include "contactvcard.h"
+#include "contactimport.h"
+
+// Contact fields are views into the store's arena
+inline wxString ToWxString(std::string_view text)
+{
+    return text.empty() ? wxString() : wxString(text.data(), text.size());
+}
+
+// Tree model of the main window: the contacts grouped by initial. The view
+// only learns about the contacts of a group while it is expanded; a
+// collapsed group offers one placeholder child so its expander is drawn.
+// Expanding swaps the placeholder for the group's rows of the store, found
+// by binary search, and the owner rebuilds the view after a collapse so the
+// released nodes are freed. Startup shows the groups only, however large
+// the agenda is.
+class ContactTreeModel : public wxDataViewModel
 {
     public:
-        ContactNode(const std::string& firstName, const std::string& lastName, const std::string& phoneNumber, const std::string& address, const std::string& companyName, const std::string& companyPhone, const std::string& companyRif, const std::string& newEvent) : firstName_(firstName), lastName_(lastName), phoneNumber_(phoneNumber), address_(address), companyName_(companyName), companyPhone_(companyPhone), companyRif_(companyRif), newEvent_(newEvent)
+        enum
         {
+            COLUMN_NAME,
+            COLUMN_PHONE,
+            COLUMN_COUNT
+        };
+
+        // Initials before 'a' share the first group and those after 'z', letters
+        // outside Latin-1 among them, the last
+        static const int GROUP_COUNT = 28;
 
+        ContactTreeModel(const ContactStore* contactStore) : contactStore_(contactStore), releasePending_(false)
+        {
+            for (Group& group : groups_)
+            {
+                group.shown = false;
+                group.expanded = false;
+            }
         }
 
-        std::string getFirstName() const
+        // Collapses every group after the whole agenda was replaced
+        void Reset()
         {
-            return firstName_;
+            for (int group = 0; group < GROUP_COUNT; group++)
+            {
+                groups_[group].shown = CountContacts(group) > 0;
+                groups_[group].expanded = false;
+            }
+            releasePending_ = false;
+            Cleared();
         }
 
-        std::string getLastName() const
+        ContactNode* GetContact(const wxDataViewItem& item) const
         {
-            return lastName_;
+            if (!item.IsOk() || GroupIndex(item) >= 0 || PlaceholderGroup(item) >= 0)
+            {
+                return nullptr;
+            }
+            return static_cast<ContactNode*>(item.GetID());
         }
 
-        std::string getFullName() const 
+        // Group of a contact, from the first byte of its sort key, where an
+        // accented initial such as Á or Ñ is already folded to its base letter
+        int GroupOf(const ContactNode* contact) const
         {
-            return firstName_ + " " + lastName_;
+            return GroupOfByte(static_cast<unsigned char>(contact->getSortKey()[0]));
         }
 
-        std::string getPhoneNumber() const 
+        wxDataViewItem GetGroupItem(int group) const
         {
-            return phoneNumber_;
+            return wxDataViewItem(const_cast<Group*>(&groups_[group]));
         }
 
-        std::string getAddress() const 
+        bool IsGroupExpanded(int group) const
         {
-            return address_;
+            return groups_[group].expanded;
         }
 
-        std::string getCompanyName() const
+        // Called as a group is about to expand
+        void ExpandGroup(const wxDataViewItem& item)
         {
-            return companyName_;
+            int group = GroupIndex(item);
+            if (group < 0 || groups_[group].expanded)
+            {
+                return;
+            }
+
+            // With the placeholder gone the view asks for the contacts once
+            groups_[group].expanded = true;
+            ItemDeleted(item, PlaceholderItem(group));
         }
 
-        std::string getCompanyPhone() const
+        // Called once a group collapsed; returns true if the owner should
+        // schedule ReleaseCollapsedGroups()
+        bool CollapseGroup(const wxDataViewItem& item)
         {
-            return companyPhone_;
+            int group = GroupIndex(item);
+            if (group < 0 || !groups_[group].expanded)
+            {
+                return false;
+            }
+            groups_[group].expanded = false;
+            bool schedule = !releasePending_;
+            releasePending_ = true;
+            return schedule;
         }
 
-        std::string getCompanyRif() const
+        // Rebuilds the view so it frees the nodes of collapsed groups.
+        // Returns the groups still expanded, for the owner to expand again.
+        wxDataViewItemArray ReleaseCollapsedGroups()
         {
-            return companyRif_;
+            wxDataViewItemArray expanded;
+            for (int group = 0; group < GROUP_COUNT; group++)
+            {
+                if (groups_[group].expanded)
+                {
+                    expanded.Add(GetGroupItem(group));
+                    groups_[group].expanded = false;
+                }
+            }
+            releasePending_ = false;
+            Cleared();
+            return expanded;
+        }
+
+        // Called after the contact was added to the store
+        void ContactAdded(ContactNode* contact)
+        {
+            int group = GroupOf(contact);
+            if (groups_[group].expanded)
+            {
+                ItemAdded(GetGroupItem(group), wxDataViewItem(contact));
+            }
+            RefreshGroup(group);
         }
 
-        std::string getNewEvent() const
+        // Called after the contact was removed from the store, with the
+        // group it was in
+        void ContactRemoved(ContactNode* contact, int group)
         {
-            return newEvent_;
+            if (groups_[group].expanded)
+            {
+                ItemDeleted(GetGroupItem(group), wxDataViewItem(contact));
+            }
+            RefreshGroup(group);
         }
 
-        void setFirstName(const std::string& firstName)
+        // Called after a rename moved the contact to another row
+        void ContactMoved(ContactNode* contact, int oldGroup)
         {
-            firstName_ = firstName;
+            ContactRemoved(contact, oldGroup);
+            ContactAdded(contact);
         }
 
-        void setLastName(const std::string& lastName)
+        void ContactChanged(ContactNode* contact)
         {
-            lastName_ = lastName;
+            if (groups_[GroupOf(contact)].expanded)
+            {
+                ItemChanged(wxDataViewItem(contact));
+            }
         }
 
-        void setPhoneNumber(const std::string& phoneNumber)
+        unsigned int GetColumnCount() const override
         {
-            phoneNumber_ = phoneNumber;
+            return COLUMN_COUNT;
         }
 
-        void setAddress(const std::string& address)
+        wxString GetColumnType(unsigned int col) const override
         {
-            address_ = address;
+            return "string";
         }
 
-        void setCompanyName(const std::string& companyName)
+        void GetValue(wxVariant& variant, const wxDataViewItem& item, unsigned int col) const override
         {
-            companyName_ = companyName;
+            int group = GroupIndex(item);
+            if (group >= 0)
+            {
+                variant = col == COLUMN_NAME ? wxString::Format("%s (%zu)", GroupLabel(group), CountContacts(group)) : wxString();
+                return;
+            }
+
+            const ContactNode* contact = GetContact(item);
+            if (!contact)
+            {
+                variant = wxString();
+            }
+            else if (col == COLUMN_NAME)
+            {
+                variant = wxString(contact->getFullName());
+            }
+            else
+            {
+                variant = ToWxString(contact->getPhoneNumber());
+            }
         }
 
-        void setCompanyPhone(const std::string& companyPhone)
+        bool SetValue(const wxVariant& variant, const wxDataViewItem& item, unsigned int col) override
         {
-            companyPhone_ = companyPhone;
+            return false;
         }
 
-        void setCompanyRif(const std::string& companyRif)
+        wxDataViewItem GetParent(const wxDataViewItem& item) const override
         {
-            companyRif_ = companyRif;
+            if (!item.IsOk() || GroupIndex(item) >= 0)
+            {
+                return wxDataViewItem();
+            }
+            int placeholderGroup = PlaceholderGroup(item);
+            if (placeholderGroup >= 0)
+            {
+                return GetGroupItem(placeholderGroup);
+            }
+            return GetGroupItem(GroupOf(static_cast<const ContactNode*>(item.GetID())));
         }
 
-        void setNewEvent(const std::string& newEvent)
+        bool IsContainer(const wxDataViewItem& item) const override
         {
-            newEvent_ = newEvent;
+            return !item.IsOk() || GroupIndex(item) >= 0;
         }
-        
-        bool operator<(const ContactNode& other) const
+
+        unsigned int GetChildren(const wxDataViewItem& item, wxDataViewItemArray& children) const override
         {
-            return getFullName() < other.getFullName();
+            if (!item.IsOk())
+            {
+                for (int group = 0; group < GROUP_COUNT; group++)
+                {
+                    if (groups_[group].shown)
+                    {
+                        children.Add(GetGroupItem(group));
+                    }
+                }
+                return static_cast<unsigned int>(children.size());
+            }
+
+            int group = GroupIndex(item);
+            if (group < 0 || !groups_[group].shown)
+            {
+                return 0;
+            }
+            if (!groups_[group].expanded)
+            {
+                children.Add(PlaceholderItem(group));
+                return 1;
+            }
+
+            const std::vector<ContactNode*>& contacts = contactStore_->GetContacts();
+            size_t end = GroupEnd(group);
+            children.reserve(children.size() + end - GroupBegin(group));
+            for (size_t row = GroupBegin(group); row < end; row++)
+            {
+                children.Add(wxDataViewItem(contacts[row]));
+            }
+            return static_cast<unsigned int>(children.size());
         }
-        
+
     private:
-        std::string firstName_;
-        std::string lastName_;
-        std::string phoneNumber_;
-        std::string address_;
-        std::string companyName_;
-        std::string companyPhone_;
-        std::string companyRif_;
-        std::string newEvent_;
+        struct Group
+        {
+            // Has contacts, so the view lists it
+            bool shown;
+
+            // The view holds its contacts instead of the placeholder
+            bool expanded;
+
+            // Only its address is used, as the placeholder item
+            char placeholder;
+        };
+
+        const ContactStore* contactStore_;
+        Group groups_[GROUP_COUNT];
+        bool releasePending_;
+
+        static int GroupOfByte(unsigned char initial)
+        {
+            if (initial < 'a')
+            {
+                return 0;
+            }
+            return initial > 'z' ? GROUP_COUNT - 1 : initial - 'a' + 1;
+        }
+
+        static wxString GroupLabel(int group)
+        {
+            if (group == 0)
+            {
+                return "#";
+            }
+            return group == GROUP_COUNT - 1 ? wxString("Other") : wxString(static_cast<char>('A' + group - 1));
+        }
+
+        int GroupIndex(const wxDataViewItem& item) const
+        {
+            for (int group = 0; group < GROUP_COUNT; group++)
+            {
+                if (item.GetID() == &groups_[group])
+                {
+                    return group;
+                }
+            }
+            return -1;
+        }
+
+        int PlaceholderGroup(const wxDataViewItem& item) const
+        {
+            for (int group = 0; group < GROUP_COUNT; group++)
+            {
+                if (item.GetID() == &groups_[group].placeholder)
+                {
+                    return group;
+                }
+            }
+            return -1;
+        }
+
+        wxDataViewItem PlaceholderItem(int group) const
+        {
+            return wxDataViewItem(const_cast<char*>(&groups_[group].placeholder));
+        }
+
+        // First row of the store whose sort key starts at or after the byte
+        size_t FirstRowFrom(unsigned int initial) const
+        {
+            const std::vector<ContactNode*>& contacts = contactStore_->GetContacts();
+            auto it = std::lower_bound(contacts.begin(), contacts.end(), initial, [](const ContactNode* contact, unsigned int value)
+            {
+                return static_cast<unsigned char>(contact->getSortKey()[0]) < value;
+            });
+            return it - contacts.begin();
+        }
+
+        size_t GroupBegin(int group) const
+        {
+            return group == 0 ? 0 : FirstRowFrom('a' + group - 1);
+        }
+
+        size_t GroupEnd(int group) const
+        {
+            return group == GROUP_COUNT - 1 ? contactStore_->Size() : FirstRowFrom('a' + group);
+        }
+
+        size_t CountContacts(int group) const
+        {
+            return GroupEnd(group) - GroupBegin(group);
+        }
+
+        // Lists a group once it has contacts and drops it once it has none,
+        // otherwise updates its count
+        void RefreshGroup(int group)
+        {
+            bool hasContacts = CountContacts(group) > 0;
+            if (hasContacts && !groups_[group].shown)
+            {
+                groups_[group].shown = true;
+                ItemAdded(wxDataViewItem(), GetGroupItem(group));
+            }
+            else if (!hasContacts && groups_[group].shown)
+            {
+                groups_[group].shown = false;
+                groups_[group].expanded = false;
+                ItemDeleted(wxDataViewItem(), GetGroupItem(group));
+            }
+            else if (hasContacts)
+            {
+                ItemChanged(GetGroupItem(group));
+            }
+        }
 };
 
-class ContactNodeData : public wxTreeItemData 
+// Virtual list model over the matches of a search. The view only asks for
+// the rows it shows, so broad queries cost nothing per hidden match.
+class SearchResultsModel : public wxDataViewVirtualListModel
 {
     public:
-        ContactNodeData(ContactNode* contactNode) : contactNode_(contactNode) 
+        enum
+        {
+            COLUMN_NAME,
+            COLUMN_PHONE,
+            COLUMN_ADDRESS,
+            COLUMN_COMPANY,
+            COLUMN_EVENT,
+            COLUMN_COUNT
+        };
+
+        SearchResultsModel() : wxDataViewVirtualListModel(0)
         {
 
         }
 
-        ContactNode* GetContactNode() const 
+        void SetContacts(std::vector<ContactNode*>& contacts)
         {
-            return contactNode_;
+            contacts_.swap(contacts);
+            Reset(static_cast<unsigned int>(contacts_.size()));
         }
 
+        unsigned int GetColumnCount() const override
+        {
+            return COLUMN_COUNT;
+        }
+
+        wxString GetColumnType(unsigned int col) const override
+        {
+            return "string";
+        }
+
+        void GetValueByRow(wxVariant& variant, unsigned row, unsigned col) const override
+        {
+            if (row >= contacts_.size())
+            {
+                return;
+            }
+
+            const ContactNode* contact = contacts_[row];
+            switch (col)
+            {
+                case COLUMN_NAME:
+                    variant = wxString(contact->getFullName());
+                    break;
+                case COLUMN_PHONE:
+                    variant = ToWxString(contact->getPhoneNumber());
+                    break;
+                case COLUMN_ADDRESS:
+                    variant = ToWxString(contact->getAddress());
+                    break;
+                case COLUMN_COMPANY:
+                    variant = ToWxString(contact->getCompanyName());
+                    break;
+                case COLUMN_EVENT:
+                    variant = ToWxString(DescribeContactEvents(contact->getNewEvent()));
+                    break;
+            }
+        }
+
+        bool SetValueByRow(const wxVariant& variant, unsigned row, unsigned col) override
+        {
+            return false;
+        }
+
+        void RemoveContact(const ContactNode* contact)
+        {
+            auto it = std::find(contacts_.begin(), contacts_.end(), contact);
+            if (it != contacts_.end())
+            {
+                unsigned int row = static_cast<unsigned int>(it - contacts_.begin());
+                contacts_.erase(it);
+                RowDeleted(row);
+            }
+        }
 
     private:
-        ContactNode* contactNode_;
+        std::vector<ContactNode*> contacts_;
+};
+
+// Offers the most used values of one contact field that start with what was typed
+class ContactFieldCompleter : public wxTextCompleter
+{
+    public:
+        ContactFieldCompleter(ContactCompletions& completions, ContactField field) : completions_(completions), field_(field), next_(0)
+        {
+
+        }
+
+        bool Start(const wxString& prefix) override
+        {
+            values_.clear();
+            next_ = 0;
+            completions_.Complete(field_, prefix.ToStdString(), values_);
+            return !values_.empty();
+        }
+
+        wxString GetNext() override
+        {
+            if (next_ == values_.size())
+            {
+                return wxString();
+            }
+            return ToWxString(values_[next_++]);
+        }
+
+    private:
+        ContactCompletions& completions_;
+        ContactField field_;
+        std::vector<std::string> values_;
+        size_t next_;
 };
 
 class SearchWindow : public wxFrame
 {
     public:
-        SearchWindow(const wxString& title, const wxPoint& pos, const wxSize& size) : wxFrame(nullptr, wxID_ANY, title, pos, size)
+        SearchWindow(const wxString& title, const wxPoint& pos, const wxSize& size, const SearchIndex* searchIndex) : wxFrame(nullptr, wxID_ANY, title, pos, size), searchIndex_(searchIndex), debounceTimer_(this), generation_(0)
         {
             // Create controls needed for search
             textCtrlSearch_ = new wxTextCtrl(this, wxID_ANY, wxEmptyString);
+            fuzzyCheckBox_ = new wxCheckBox(this, wxID_ANY, "Fuzzy name match");
             buttonClose_ = new wxButton(this, wxID_ANY, "Close");
-            listBoxResults_ = new wxListBox(this, wxID_ANY);
+            listResults_ = new wxDataViewCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxDV_ROW_LINES);
+            resultsModel_ = new SearchResultsModel();
+            listResults_->AssociateModel(resultsModel_);
+            resultsModel_->DecRef();
+            listResults_->AppendTextColumn("Name", SearchResultsModel::COLUMN_NAME, wxDATAVIEW_CELL_INERT, 200);
+            listResults_->AppendTextColumn("Phone", SearchResultsModel::COLUMN_PHONE, wxDATAVIEW_CELL_INERT, 120);
+            listResults_->AppendTextColumn("Address", SearchResultsModel::COLUMN_ADDRESS, wxDATAVIEW_CELL_INERT, 200);
+            listResults_->AppendTextColumn("Company", SearchResultsModel::COLUMN_COMPANY, wxDATAVIEW_CELL_INERT, 150);
+            listResults_->AppendTextColumn("Event", SearchResultsModel::COLUMN_EVENT, wxDATAVIEW_CELL_INERT, 150);
 
             // configure window layout
             wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
             sizer->Add(new wxStaticText(this, wxID_ANY, "Search Contacts:"), 0, wxALL, 5);
             sizer->Add(textCtrlSearch_, 0, wxEXPAND | wxALL, 5);
-            sizer->Add(listBoxResults_, 1, wxEXPAND | wxALL, 5);
+            sizer->Add(fuzzyCheckBox_, 0, wxLEFT | wxRIGHT, 5);
+            sizer->Add(listResults_, 1, wxEXPAND | wxALL, 5);
             sizer->Add(buttonClose_, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
             SetSizerAndFit(sizer);
 
             //Automatic frame update
             textCtrlSearch_->Connect(wxEVT_TEXT, wxCommandEventHandler(SearchWindow::OnSearchTextChanged), nullptr, this);
+            fuzzyCheckBox_->Connect(wxEVT_CHECKBOX, wxCommandEventHandler(SearchWindow::OnSearchTextChanged), nullptr, this);
 
             // Connect search button event
             buttonClose_->Connect(wxEVT_BUTTON, wxCommandEventHandler(SearchWindow::OnCloseButtonClicked), nullptr, this);
 
+            // Queries run on a worker thread once typing pauses
+            Bind(wxEVT_TIMER, &SearchWindow::OnDebounceTimer, this, debounceTimer_.GetId());
+            Bind(wxEVT_THREAD, &SearchWindow::OnSearchResults, this);
+            searchWorker_ = new SearchWorker(this, searchIndex_);
+            if (searchWorker_->Run() != wxTHREAD_NO_ERROR)
+            {
+                delete searchWorker_;
+                searchWorker_ = nullptr;
+            }
+
             // Set window size and position
             int screenWidth, screenHeight;
             wxDisplaySize(&screenWidth, &screenHeight);
@@ -169,46 +566,293 @@ class SearchWindow : public wxFrame
             SetSize(windowX, windowY, windowWidth, windowHeight);
         }
 
+        ~SearchWindow()
+        {
+            StopSearching();
+        }
+
+        // Drops a contact that is about to be deleted from the shown rows
+        void RemoveContact(const ContactNode* contact)
+        {
+            resultsModel_->RemoveContact(contact);
+            RefreshResults();
+        }
+
+        // Drops every shown row before the whole agenda is replaced
+        void ClearResults()
+        {
+            std::vector<ContactNode*> none;
+            resultsModel_->SetContacts(none);
+            RefreshResults();
+        }
+
+        // Runs the current query again after contacts were added or edited
+        void RefreshResults()
+        {
+            if (!textCtrlSearch_->IsEmpty())
+            {
+                SubmitQuery();
+            }
+        }
+
+        // Stops the worker thread, it must not outlive the index it reads
+        void StopSearching()
+        {
+            debounceTimer_.Stop();
+            if (searchWorker_)
+            {
+                searchWorker_->Stop();
+                searchWorker_->Wait();
+                delete searchWorker_;
+                searchWorker_ = nullptr;
+            }
+        }
+
     private:
-        
+        // Quiet period after a keystroke before the query is sent to the worker
+        static const int SEARCH_DEBOUNCE_MS = 40;
+
         wxTextCtrl* textCtrlSearch_;
+        wxCheckBox* fuzzyCheckBox_;
         wxButton* buttonClose_;
-        wxListBox* listBoxResults_;
+        wxDataViewCtrl* listResults_;
+        SearchResultsModel* resultsModel_;
+        const SearchIndex* searchIndex_;
+        SearchWorker* searchWorker_;
+        wxTimer debounceTimer_;
+        std::uint64_t generation_;
 
         void OnSearchTextChanged(wxCommandEvent& event)
         {
-            wxString searchText = textCtrlSearch_->GetValue();
-            listBoxResults_->Clear();
+            // Any query still in flight is stale now, the worker stops it at once
+            generation_++;
+            if (searchWorker_)
+            {
+                searchWorker_->Cancel(generation_);
+            }
+            debounceTimer_.StartOnce(SEARCH_DEBOUNCE_MS);
+        }
+
+        void OnDebounceTimer(wxTimerEvent& event)
+        {
+            SubmitQuery();
+        }
+
+        void SubmitQuery()
+        {
+            if (searchWorker_)
+            {
+                generation_++;
+                searchWorker_->Submit(textCtrlSearch_->GetValue().ToStdString(), generation_, fuzzyCheckBox_->GetValue());
+            }
+        }
 
-            //Get matching contacts
-            std::vector<wxString> matchingContacts;
+        void OnSearchResults(wxThreadEvent& event)
+        {
+            SearchReply reply = event.GetPayload<SearchReply>();
+            if (reply.generation != generation_)
+            {
+                return;
+            }
 
-            //Find the file and display the results in the tree.
-            std::ifstream file("contacts.txt");
-            if (file.is_open())
+            // Contacts may have been edited or deleted while the worker ran
+            if (reply.result.version != searchIndex_->GetVersion())
             {
-                std::string line;
-                while (std::getline(file, line))
-                {
-                    // Find the search string in each line of the file
-                    if (line.find(searchText.ToStdString()) != std::string::npos)
-                    {
-                        //Add the matching contact to the tree
-                        listBoxResults_->Append(wxString(line));
-                    }
-                }
-                file.close();
+                SubmitQuery();
+                return;
+            }
+
+            // Results arrive sorted, the view only reads the visible rows
+            resultsModel_->SetContacts(reply.result.contacts);
+        }
+
+        void OnCloseButtonClicked(wxCommandEvent& event)
+        {
+            Close();
+        }
+};
+
+
+// Virtual list model over events found in the event index, in start order
+class EventListModel : public wxDataViewVirtualListModel
+{
+    public:
+        enum
+        {
+            COLUMN_START,
+            COLUMN_CONTACT,
+            COLUMN_TITLE,
+            COLUMN_NOTES,
+            COLUMN_COUNT
+        };
+
+        EventListModel() : wxDataViewVirtualListModel(0)
+        {
+
+        }
+
+        void SetEvents(std::vector<EventEntry>& events)
+        {
+            events_.swap(events);
+            Reset(static_cast<unsigned int>(events_.size()));
+        }
+
+        const EventEntry* GetEvent(const wxDataViewItem& item) const
+        {
+            if (!item.IsOk())
+            {
+                return nullptr;
+            }
+            unsigned int row = GetRow(item);
+            return row < events_.size() ? &events_[row] : nullptr;
+        }
+
+        unsigned int GetColumnCount() const override
+        {
+            return COLUMN_COUNT;
+        }
+
+        wxString GetColumnType(unsigned int col) const override
+        {
+            return "string";
+        }
+
+        void GetValueByRow(wxVariant& variant, unsigned row, unsigned col) const override
+        {
+            if (row >= events_.size())
+            {
+                return;
+            }
+
+            // Only the shown rows are decoded from their contact's event field
+            const EventEntry& entry = events_[row];
+            std::vector<ContactEvent> events;
+            if (!ParseContactEvents(entry.contact->getNewEvent(), events) || entry.ordinal >= events.size())
+            {
+                return;
+            }
+            const ContactEvent& event = events[entry.ordinal];
+            switch (col)
+            {
+                case COLUMN_START:
+                    variant = event.start.Format("%Y-%m-%d %H:%M");
+                    break;
+                case COLUMN_CONTACT:
+                    variant = wxString(entry.contact->getFullName());
+                    break;
+                case COLUMN_TITLE:
+                    variant = ToWxString(event.title);
+                    break;
+                case COLUMN_NOTES:
+                    variant = ToWxString(event.notes);
+                    break;
+            }
+        }
+
+        bool SetValueByRow(const wxVariant& variant, unsigned row, unsigned col) override
+        {
+            return false;
+        }
+
+    private:
+        std::vector<EventEntry> events_;
+};
+
+// Lists the events of the coming days or of one date, read from the event
+// index of the contact store instead of every contact
+class EventsWindow : public wxFrame
+{
+    public:
+        typedef std::function<void(ContactNode*, size_t)> DeleteEventHandler;
+
+        EventsWindow(const wxString& title, const wxPoint& pos, const wxSize& size, const EventIndex* eventIndex, const DeleteEventHandler& deleteEvent) : wxFrame(nullptr, wxID_ANY, title, pos, size), eventIndex_(eventIndex), deleteEvent_(deleteEvent)
+        {
+            wxString ranges[] = {wxString::Format("Next %d days", UPCOMING_DAYS), "On date"};
+            rangeChoice_ = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, WXSIZEOF(ranges), ranges);
+            rangeChoice_->SetSelection(0);
+            datePicker_ = new wxDatePickerCtrl(this, wxID_ANY);
+            datePicker_->Enable(false);
+            buttonDelete_ = new wxButton(this, wxID_ANY, "Delete event");
+            buttonClose_ = new wxButton(this, wxID_ANY, "Close");
+            listEvents_ = new wxDataViewCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxDV_SINGLE | wxDV_ROW_LINES);
+            eventsModel_ = new EventListModel();
+            listEvents_->AssociateModel(eventsModel_);
+            eventsModel_->DecRef();
+            listEvents_->AppendTextColumn("When", EventListModel::COLUMN_START, wxDATAVIEW_CELL_INERT, 140);
+            listEvents_->AppendTextColumn("Contact", EventListModel::COLUMN_CONTACT, wxDATAVIEW_CELL_INERT, 200);
+            listEvents_->AppendTextColumn("Event", EventListModel::COLUMN_TITLE, wxDATAVIEW_CELL_INERT, 200);
+            listEvents_->AppendTextColumn("Notes", EventListModel::COLUMN_NOTES, wxDATAVIEW_CELL_INERT, 250);
+
+            // configure window layout
+            wxBoxSizer* rangeSizer = new wxBoxSizer(wxHORIZONTAL);
+            rangeSizer->Add(rangeChoice_, 0, wxALL, 5);
+            rangeSizer->Add(datePicker_, 0, wxALL, 5);
+            wxBoxSizer* buttonSizer = new wxBoxSizer(wxHORIZONTAL);
+            buttonSizer->Add(buttonDelete_, 0, wxALL, 5);
+            buttonSizer->Add(buttonClose_, 0, wxALL, 5);
+            wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+            sizer->Add(rangeSizer, 0, wxEXPAND);
+            sizer->Add(listEvents_, 1, wxEXPAND | wxALL, 5);
+            sizer->Add(buttonSizer, 0, wxALIGN_CENTER_HORIZONTAL);
+            SetSizerAndFit(sizer);
+
+            rangeChoice_->Bind(wxEVT_CHOICE, &EventsWindow::OnRangeChanged, this);
+            datePicker_->Bind(wxEVT_DATE_CHANGED, &EventsWindow::OnDateChanged, this);
+            buttonDelete_->Bind(wxEVT_BUTTON, &EventsWindow::OnDeleteButtonClicked, this);
+            buttonClose_->Bind(wxEVT_BUTTON, &EventsWindow::OnCloseButtonClicked, this);
+
+            SetSize(pos.x, pos.y, size.GetWidth(), size.GetHeight());
+            RefreshEvents();
+        }
+
+        // Queries the index again after events were added, edited or deleted
+        void RefreshEvents()
+        {
+            std::vector<EventEntry> found;
+            if (rangeChoice_->GetSelection() == 0)
+            {
+                wxDateTime now = wxDateTime::Now();
+                eventIndex_->FindBetween(now, now + wxDateSpan::Days(UPCOMING_DAYS), found);
+            }
+            else
+            {
+                eventIndex_->FindOnDate(datePicker_->GetValue(), found);
             }
+            eventsModel_->SetEvents(found);
+        }
+
+    private:
+        // Days listed by the default range
+        static const int UPCOMING_DAYS = 7;
+
+        wxChoice* rangeChoice_;
+        wxDatePickerCtrl* datePicker_;
+        wxButton* buttonDelete_;
+        wxButton* buttonClose_;
+        wxDataViewCtrl* listEvents_;
+        EventListModel* eventsModel_;
+        const EventIndex* eventIndex_;
+        DeleteEventHandler deleteEvent_;
+
+        void OnRangeChanged(wxCommandEvent& event)
+        {
+            datePicker_->Enable(rangeChoice_->GetSelection() == 1);
+            RefreshEvents();
+        }
 
-            //Sort the results
-            std::sort(matchingContacts.begin(), matchingContacts.end());
+        void OnDateChanged(wxDateEvent& event)
+        {
+            RefreshEvents();
+        }
 
-            // Add the sorted results to the listBoxResults_
-            for (const auto& contact : matchingContacts)
+        void OnDeleteButtonClicked(wxCommandEvent& event)
+        {
+            const EventEntry* entry = eventsModel_->GetEvent(listEvents_->GetSelection());
+            if (entry && wxMessageBox("Are you sure you want to delete this event?", "Confirm Deletion", wxYES_NO | wxICON_QUESTION) == wxYES)
             {
-                listBoxResults_->Append(contact);
+                // The owner edits the contact and refreshes this window
+                deleteEvent_(entry->contact, entry->ordinal);
             }
-
         }
 
         void OnCloseButtonClicked(wxCommandEvent& event)
@@ -217,21 +861,24 @@ class SearchWindow : public wxFrame
         }
 };
 
-
 class TeleAddressWindow : public wxFrame
 {
     public:
         
         TeleAddressWindow(const wxString& title, const wxPoint& pos, const wxSize& size) : wxFrame(nullptr, wxID_ANY, title, pos, size)
     {
-        // Create contact tree
-        contactTree_ = new wxTreeCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxTR_DEFAULT_STYLE | wxTR_FULL_ROW_HIGHLIGHT);
-
-        //root of the tree
-        wxTreeItemId rootItemId = contactTree_->AddRoot("Contacts");
+        // Create contact list, a virtual view over the contact store
+        contactList_ = new wxDataViewCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxDV_SINGLE | wxDV_ROW_LINES);
+        contactModel_ = new ContactTreeModel(&contactStore_);
+        contactList_->AssociateModel(contactModel_);
+        contactModel_->DecRef();
+        contactList_->AppendTextColumn("Contacts", ContactTreeModel::COLUMN_NAME, wxDATAVIEW_CELL_INERT, 250);
+        contactList_->AppendTextColumn("Phone", ContactTreeModel::COLUMN_PHONE, wxDATAVIEW_CELL_INERT, 150);
 
         // Set up events
-        contactTree_->Bind(wxEVT_TREE_SEL_CHANGED, &TeleAddressWindow::OnContactSelected, this);
+        contactList_->Bind(wxEVT_DATAVIEW_SELECTION_CHANGED, &TeleAddressWindow::OnContactSelected, this);
+        contactList_->Bind(wxEVT_DATAVIEW_ITEM_EXPANDING, &TeleAddressWindow::OnGroupExpanding, this);
+        contactList_->Bind(wxEVT_DATAVIEW_ITEM_COLLAPSED, &TeleAddressWindow::OnGroupCollapsed, this);
 
         // Create controls to add new contact
         textCtrlFirstName_ = new wxTextCtrl(this, wxID_ANY, wxEmptyString);
@@ -242,12 +889,21 @@ class TeleAddressWindow : public wxFrame
         companyPhoneCtrl_ = new wxTextCtrl(this, wxID_ANY, wxEmptyString);
         companyRifCtrl_ = new wxTextCtrl(this, wxID_ANY, wxEmptyString);
         newEventCtrl_ = new wxTextCtrl(this,wxID_ANY, wxEmptyString);
+        eventDatePicker_ = new wxDatePickerCtrl(this, wxID_ANY);
+        eventTimePicker_ = new wxTimePickerCtrl(this, wxID_ANY);
+        eventNotesCtrl_ = new wxTextCtrl(this, wxID_ANY, wxEmptyString);
         buttonAdd_ = new wxButton(this, wxID_ANY, "Add");
         buttonAdd_->Bind(wxEVT_BUTTON, &TeleAddressWindow::OnAddButtonClicked, this);
+
+        // Complete the fields that are retyped most, the controls own the completers
+        textCtrlFirstName_->AutoComplete(new ContactFieldCompleter(completions_, FIELD_FIRST_NAME));
+        textCtrlLastName_->AutoComplete(new ContactFieldCompleter(completions_, FIELD_LAST_NAME));
+        textCtrlAddress_->AutoComplete(new ContactFieldCompleter(completions_, FIELD_ADDRESS));
+        companyNameCtrl_->AutoComplete(new ContactFieldCompleter(completions_, FIELD_COMPANY_NAME));
         
         // Set the window layout
         wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL); //HORIZONTAL
-        sizer->Add(contactTree_, 1, wxEXPAND | wxALL, 5);
+        sizer->Add(contactList_, 1, wxEXPAND | wxALL, 5);
 
         //CheckBox belongs to a company
         companyCheckBox_ = new wxCheckBox(this, wxID_ANY, "Belongs to a company?");
@@ -288,6 +944,11 @@ class TeleAddressWindow : public wxFrame
         //Event box
         eventSizer_->Add(new wxStaticText(this, wxID_ANY, "Event:"), 0, wxALL, 5);
         eventSizer_->Add(newEventCtrl_, 0, wxALL, 5);
+        eventSizer_->Add(new wxStaticText(this, wxID_ANY, "Date:"), 0, wxALL, 5);
+        eventSizer_->Add(eventDatePicker_, 0, wxALL, 5);
+        eventSizer_->Add(eventTimePicker_, 0, wxALL, 5);
+        eventSizer_->Add(new wxStaticText(this, wxID_ANY, "Notes:"), 0, wxALL, 5);
+        eventSizer_->Add(eventNotesCtrl_, 0, wxALL, 5);
         eventSizer_->Show(false);
 
 
@@ -296,6 +957,10 @@ class TeleAddressWindow : public wxFrame
         buttonOpenSearch_->Connect(wxEVT_BUTTON, wxCommandEventHandler(TeleAddressWindow::OnSearchButtonClicked), nullptr, this);
         addSizer->Add(buttonOpenSearch_, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
 
+        buttonOpenEvents_ = new wxButton(this, wxID_ANY, "Events");
+        buttonOpenEvents_->Connect(wxEVT_BUTTON, wxCommandEventHandler(TeleAddressWindow::OnEventsButtonClicked), nullptr, this);
+        addSizer->Add(buttonOpenEvents_, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
+
         buttonEdit_ = new wxButton(this, wxID_ANY, "Edit");
         buttonEdit_->Connect(wxEVT_BUTTON, wxCommandEventHandler(TeleAddressWindow::OnEditButtonClicked), nullptr, this);
         addSizer->Add(buttonEdit_, 0, wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
@@ -315,14 +980,33 @@ class TeleAddressWindow : public wxFrame
         companyCheckBox_->Connect(wxEVT_CHECKBOX, wxCommandEventHandler(TeleAddressWindow::OnCompanyCheckBox), nullptr, this);
 
         eventCheckBox_->Connect(wxEVT_CHECKBOX, wxCommandEventHandler(TeleAddressWindow::OnEventCheckBox), nullptr, this);
+
+        // One timer drives the reminder wheel of the contact store
+        Bind(wxEVT_TIMER, &TeleAddressWindow::OnReminderTimer, this, reminderTimer_.GetId());
+        reminderTimer_.Start(REMINDER_TICK_MS);
         Maximize();
 
     }
 
+    ~TeleAddressWindow()
+    {
+        // The search window reads our index, it must go with us
+        if(searchWindow_)
+        {
+            searchWindow_->StopSearching();
+            searchWindow_->Destroy();
+        }
+        // The events window reads our event index
+        if(eventsWindow_)
+        {
+            eventsWindow_->Destroy();
+        }
+    }
+
     void OnExportButtonClicked(wxCommandEvent& event)
     {
         //save window
-        wxFileDialog saveFileDialog(this, "Export contacts", "", "", "CSV Files (*.csv)|*.csv", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        wxFileDialog saveFileDialog(this, "Export contacts", "", "", "CSV Files (*.csv)|*.csv|vCard Files (*.vcf)|*.vcf", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
         if (saveFileDialog.ShowModal() == wxID_CANCEL)
         {
             return;
@@ -330,128 +1014,131 @@ class TeleAddressWindow : public wxFrame
 
         std::string exportFilePathStdString = saveFileDialog.GetPath().ToStdString();
 
-        // Automatically add the .csv extension if it is not present
-        if (exportFilePathStdString.substr(exportFilePathStdString.length() - 4) != ".csv")
+        // Automatically add the extension of the chosen format if it is not present
+        bool asVcard = saveFileDialog.GetFilterIndex() == 1;
+        std::string extension = asVcard ? ".vcf" : ".csv";
+        if (exportFilePathStdString.size() < 4 || exportFilePathStdString.substr(exportFilePathStdString.length() - 4) != extension)
         {
-            exportFilePathStdString += ".csv";
+            exportFilePathStdString += extension;
         }
 
-        // Open CSV file for writing
-        std::ofstream outputFile(exportFilePathStdString);
-        if (!outputFile.is_open())
+        // Written from the store in memory, contacts.txt is not read back. The
+        // progress dialog is modal, so nothing edits the store while it is read.
+        JobProgress progress;
+        bool exported = false;
+        RunWithProgress("Exporting contacts", progress, false, [&]()
         {
-            // Error opening file
-            return;
-        }
+            if (asVcard)
+            {
+                exported = ExportContactsVcard(contactStore_.GetContacts(), exportFilePathStdString, &progress);
+            }
+            else
+            {
+                exported = ExportContactsCsv(contactStore_.GetContacts(), exportFilePathStdString, &progress);
+            }
+        });
 
-        std::ifstream inputFile("contacts.txt");
-        if (!inputFile.is_open())
+        // A cancel that arrives after the file was renamed into place comes too late
+        if (exported)
         {
-            // Error opening contacts file
-            outputFile.close();
             return;
         }
-
-        // Get the contact data to be exported
-        std::vector<std::vector<std::string>> contactData;
-
-        std::string line;
-
-        while (std::getline(inputFile, line))
+        if (progress.IsCancelled())
         {
-            std::istringstream iss(line);
-            std::vector<std::string> rowData;
-
-            std::string field;
-            while (std::getline(iss, field))
-            {
-                rowData.push_back(field);
-            }
-
-            contactData.push_back(rowData);
+            wxLogMessage("Export cancelled, %s was not changed.", exportFilePathStdString);
         }
-
-        inputFile.close();
-
-        // Write contact data to a CSV file
-        for (const auto& rowData : contactData)
+        else
         {
-            for (const auto& field : rowData)
-            {
-                outputFile << field << ",";
-            }
-            outputFile << "\n";
+            wxLogError("Could not export contacts to %s", exportFilePathStdString);
         }
-
-        outputFile.close();
     }
 
     void OnImportButtonClicked(wxCommandEvent& event)
     {
-        wxFileDialog openFileDialog(this, "Import contacts","","","CSV Files (*.csv)|*.csv", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+        wxFileDialog openFileDialog(this, "Import contacts","","","CSV and vCard Files (*.csv;*.vcf)|*.csv;*.vcf|CSV Files (*.csv)|*.csv|vCard Files (*.vcf)|*.vcf", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
         if (openFileDialog.ShowModal() == wxID_CANCEL)
         {
             return;
         }
 
         std::string importFilePathStdString = openFileDialog.GetPath().ToStdString();
-        
-        // Abrir el archivo CSV para lectura
-        std::ifstream inputFile(importFilePathStdString);
-        if (!inputFile.is_open())
+
+        // Rows are joined against the stored contacts as the file streams in.
+        // Only the steps after Run() change the store, so a cancelled import
+        // changes nothing.
+        ContactImporter importer(contactStore_);
+        JobProgress progress;
+        bool opened = false;
+        bool finished = RunWithProgress("Importing contacts", progress, true, [&]()
+        {
+            opened = importer.Run(importFilePathStdString, &progress);
+        });
+
+        if (!finished)
+        {
+            wxLogMessage("Import cancelled, no contact was changed.");
+            return;
+        }
+        if (!opened)
         {
-            // Error al abrir el archivo
+            wxLogError("Could not open %s", importFilePathStdString);
             return;
         }
 
-        std::vector<std::vector<std::string>> contactData;
+        std::vector<ContactNode*> updated;
+        std::vector<ContactNode*> added;
+        if (!importer.ApplyUpdates(contactStore_, journal_, updated))
+        {
+            wxLogError("Could not read %s again, no contact was changed.", importFilePathStdString);
+            return;
+        }
 
-        std::string line;
-        while (std::getline(inputFile, line))
+        // The file is read again on the worker for the rows to add, which
+        // are created here batch by batch while the dialog shows progress
+        JobProgress addProgress;
+        RunWithProgress("Adding contacts", addProgress, true, [&]()
+        {
+            importer.ReadAdditions(&addProgress);
+        }, [&]()
         {
-            std::istringstream iss(line);
-            std::vector<std::string> rowData;
+            return importer.AddReadRows(contactStore_, journal_);
+        });
+        importer.FinishAdditions(contactStore_, updated, added);
+        completions_.MarkStale();
+        contactModel_->Reset();
 
-            std::string field;
-            while (std::getline(iss, field, ','))
+        if (!searchIndexStale_)
+        {
+            for (ContactNode* contact : updated)
             {
-                rowData.push_back(field);
+                searchIndex_.UpdateContact(contact);
+            }
+            for (ContactNode* contact : added)
+            {
+                searchIndex_.AddContact(contact);
             }
-
-            contactData.push_back(rowData);
         }
-
-        inputFile.close();
-
-       // Guardar los contactos importados en el archivo "Contacts.txt"
-        std::ofstream outputFile("contacts.txt");
-        if (!outputFile.is_open())
+        if (searchWindow_)
         {
-            // Error al abrir el archivo
-            return;
+            searchWindow_->RefreshResults();
         }
-
-        for (const auto& rowData : contactData)
+        if (eventsWindow_)
         {
-            bool firstField = true;
+            eventsWindow_->RefreshEvents();
+        }
+        SaveContactsToFile();
 
-            for (const auto& field : rowData)
+        const ImportSummary& summary = importer.GetSummary();
+        wxString report = wxString::Format("Imported %zu rows: %zu added, %zu updated, %zu unchanged.", summary.rows, summary.added, summary.updated, summary.unchanged);
+        if (summary.conflicts > 0 || summary.skipped > 0 || summary.duplicatePhones > 0)
+        {
+            report += wxString::Format("\n%zu updates replaced different values, %zu rows were skipped, %zu added rows share a phone number with another contact.\nSee lines:", summary.conflicts, summary.skipped, summary.duplicatePhones);
+            for (size_t line : summary.reportedLines)
             {
-                if(!firstField)
-                {
-                    outputFile << ",";
-                }
-
-                outputFile << field;
-                firstField = false;
-
+                report += wxString::Format(" %zu", line);
             }
-
-            outputFile << "\n";
         }
-
-        outputFile.close();
-
+        wxLogMessage("%s", report);
     }
 
     void OnCompanyCheckBox(wxCommandEvent& event)
@@ -478,93 +1165,85 @@ class TeleAddressWindow : public wxFrame
 
     void LoadContactsFromFile()
     {
-        std::ifstream inputFile(fileName);
-        if (inputFile.is_open())
+        // Free the current contacts and their arena before loading again
+        if(searchWindow_)
         {
-            std::vector<std::pair<std::string, std::string>> contacts;
-            std::string line;
-            while (std::getline(inputFile, line))
-            {
-                // Separate the line in contact fields
-                std::istringstream iss(line);
-                std::string fullName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent;
-                std::getline(iss, fullName, ',');
-                std::getline(iss, phoneNumber, ',');
-                std::getline(iss, address, ',');
-                std::getline(iss, companyName, ',');
-                std::getline(iss, companyPhone, ',');
-                std::getline(iss, companyRif, ',');
-                std::getline(iss, newEvent, ',');
+            searchWindow_->ClearResults();
+        }
+        contactStore_.Clear();
+        contactModel_->Reset();
+        if(eventsWindow_)
+        {
+            eventsWindow_->RefreshEvents();
+        }
 
-                // Add the contact to the vector
-                contacts.push_back(std::make_pair(fullName, line));
-            }
-            inputFile.close();
+        // contacts.txt with the journal replayed on top
+        std::vector<ContactNode*> contacts;
+        journal_.Load(contactStore_, contacts);
 
-            // Sort contacts alphabetically
-            std::sort(contacts.begin(), contacts.end(), [](const std::pair<std::string, std::string>& a, const std::pair<std::string, std::string>& b) 
-            {
-                    return a.first < b.first;
-            });
+        // The store sorts them alphabetically
+        SetContacts(contacts);
+    }
 
-            // Add contacts to the tree in alphabetical order
-            wxTreeItemId rootItemId = contactTree_->GetRootItem();
-            for (const auto& contact : contacts)
-            {
-                wxString fullName(contact.first);
-                wxString contactInfo(contact.second);
-
-                // Create a new ContactNode object using the contact data
-                std::istringstream iss(contact.second);
-                std::string firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent;
-                std::getline(iss, firstName, ',');
-                std::getline(iss, lastName, ',');
-                std::getline(iss, phoneNumber, ',');
-                std::getline(iss, address, ',');
-                if(iss)
-                {
-                    std::getline(iss, companyName, ',');
-                    std::getline(iss, companyPhone, ',');
-                    std::getline(iss, companyRif, ',');
-                    std::getline(iss, newEvent, ',');
-                }
-                else
-                {
-                    companyName = "";
-                    companyPhone = "";
-                    companyRif = "";
-                    newEvent = "";
-                }
-                
-                ContactNode* contactNode = new ContactNode(firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent);
+    // Replaces the shown contacts, taking ownership of them
+    void SetContacts(std::vector<ContactNode*>& contacts)
+    {
+        if(searchWindow_)
+        {
+            searchWindow_->ClearResults();
+        }
+        contactStore_.Assign(contacts);
+        contactModel_->Reset();
+        completions_.MarkStale();
+        if(eventsWindow_)
+        {
+            eventsWindow_->RefreshEvents();
+        }
 
-                // Create ContactNodeData with ContactNode object
-                contactTree_->AppendItem(rootItemId, fullName, -1, -1, new ContactNodeData(contactNode));
-            }
+        // Indexing reads every field, leave it until a search needs it
+        if(searchWindow_)
+        {
+            RebuildSearchIndex();
+        }
+        else
+        {
+            searchIndex_.Clear();
+            searchIndexStale_ = true;
         }
     }
 
-    wxTreeCtrl* GetContactTree() const 
-    { 
-        return contactTree_; 
+    void RebuildSearchIndex()
+    {
+        //index every contact currently stored
+        searchIndex_.Clear();
+        searchIndexStale_ = false;
+        for (ContactNode* contact : contactStore_.GetContacts())
+        {
+            searchIndex_.AddContact(contact);
+        }
     }
 
-    void OnContactSelected(wxTreeEvent& event)
+    void OnContactSelected(wxDataViewEvent& event)
     {
         
-        wxTreeItemId itemId = event.GetItem();
-        ContactNodeData* contactData = dynamic_cast<ContactNodeData*>(contactTree_->GetItemData(itemId));
-        if (contactData)
+        ContactNode* contact = contactModel_->GetContact(event.GetItem());
+        if (contact)
         {
-            ContactNode* contact = contactData->GetContactNode();
             wxString fullName(contact->getFullName());
-            wxString phoneNumber(contact->getPhoneNumber());
-            wxString address(contact->getAddress());
-            wxString companyName(contact->getCompanyName());
-            wxString companyPhone(contact->getCompanyPhone());
-            wxString companyRif(contact->getCompanyRif());
-            wxString newEvent(contact->getNewEvent());
-            if(contact->getCompanyName() == "" || contact->getCompanyPhone() == "" || contact->getCompanyRif() == "" || contact->getNewEvent() == "")
+            wxString phoneNumber = ToWxString(contact->getPhoneNumber());
+            wxString address = ToWxString(contact->getAddress());
+            wxString companyName = ToWxString(contact->getCompanyName());
+            wxString companyPhone = ToWxString(contact->getCompanyPhone());
+            wxString companyRif = ToWxString(contact->getCompanyRif());
+            wxString newEvent = ToWxString(DescribeContactEvents(contact->getNewEvent()));
+            if(contact->getCompanyId() != CompanyTable::NO_COMPANY)
+            {
+                // The company table lists its contacts, no scan of the agenda needed
+                size_t members = contactStore_.GetCompanies().Get(contact->getCompanyId()).contacts.size();
+                size_t colleagues = members > 0 ? members - 1 : 0;
+                companyName += wxString::Format(" (%zu other contacts)", colleagues);
+            }
+            if(contact->getCompanyName().empty() || contact->getCompanyPhone().empty() || contact->getCompanyRif().empty() || contact->getNewEvent().empty())
             {
                 wxLogMessage("Selected contact: %s\nPhone: %s\nAddress: %s", fullName, phoneNumber, address);
             }
@@ -577,27 +1256,79 @@ class TeleAddressWindow : public wxFrame
         }
     }
 
-    void SaveContactsToFile()
+    // The contacts of a group are handed to the list as it expands
+    void OnGroupExpanding(wxDataViewEvent& event)
+    {
+        contactModel_->ExpandGroup(event.GetItem());
+    }
+
+    void OnGroupCollapsed(wxDataViewEvent& event)
+    {
+        if (contactModel_->CollapseGroup(event.GetItem()))
+        {
+            // The list still walks its nodes while the collapse is reported
+            CallAfter(&TeleAddressWindow::ReleaseCollapsedGroups);
+        }
+    }
+
+    // Rebuilds the list without the contacts of collapsed groups, keeping
+    // the other groups open and the selection
+    void ReleaseCollapsedGroups()
+    {
+        ContactNode* selected = contactModel_->GetContact(contactList_->GetSelection());
+        wxDataViewItemArray expanded = contactModel_->ReleaseCollapsedGroups();
+        for (const wxDataViewItem& group : expanded)
+        {
+            contactList_->Expand(group);
+        }
+        if (selected && contactModel_->IsGroupExpanded(contactModel_->GroupOf(selected)))
+        {
+            contactList_->Select(wxDataViewItem(selected));
+        }
+    }
+
+    // Opens the contact's group and selects it
+    void ShowContact(ContactNode* contact)
+    {
+        contactList_->Expand(contactModel_->GetGroupItem(contactModel_->GroupOf(contact)));
+        contactList_->Select(wxDataViewItem(contact));
+        contactList_->EnsureVisible(wxDataViewItem(contact));
+    }
+
+    // Name the company with this RIF has now, empty if it is not known
+    std::string CompanyNameOf(const std::string& companyRif) const
+    {
+        std::uint32_t companyId = contactStore_.GetCompanies().Find(companyRif);
+        return companyId != CompanyTable::NO_COMPANY ? contactStore_.GetCompanies().Get(companyId).name : std::string();
+    }
+
+    // A company was renamed or got a new phone, its contacts show and find the
+    // new values. The edited contact already has its completions updated.
+    void RefreshCompanyContacts(std::uint32_t companyId, const std::string& oldName, const ContactNode* edited)
     {
-        //loops through the contacts stored in the tree and writes their data to a file
-        std::ofstream outputFile(fileName);
-        if(outputFile.is_open())
+        const Company& company = contactStore_.GetCompanies().Get(companyId);
+        for (ContactNode* contact : company.contacts)
         {
-            wxTreeItemIdValue cookie;
-            wxTreeItemId rootItemId = contactTree_->GetRootItem();
-            wxTreeItemId itemId = contactTree_->GetFirstChild(rootItemId, cookie);
-            while(itemId.IsOk())
+            contactModel_->ContactChanged(contact);
+            if (!searchIndexStale_)
             {
-                ContactNodeData* contactData = dynamic_cast<ContactNodeData*>(contactTree_->GetItemData(itemId));
-                if(contactData)
-                {
-                    ContactNode* contact = contactData->GetContactNode();
-                    outputFile << contact->getFirstName() << "," << contact->getLastName() << "," << contact->getPhoneNumber() << "," << contact->getAddress() << "," << contact->getCompanyName() << "," << contact->getCompanyPhone() << "," << contact->getCompanyRif() << "," << contact->getNewEvent() << "\n";
-                }
-                itemId = contactTree_->GetNextChild(rootItemId, cookie);
+                searchIndex_.UpdateContact(contact);
+            }
+            if (contact != edited)
+            {
+                completions_.CompanyRenamed(oldName, company.name);
             }
-            outputFile.close();
         }
+        if (searchWindow_)
+        {
+            searchWindow_->RefreshResults();
+        }
+    }
+
+    void SaveContactsToFile()
+    {
+        //every change is already in the journal, fold it into the file once it grows
+        journal_.CompactIfNeeded(contactStore_.GetContacts());
     }
 
     void OnAddButtonClicked(wxCommandEvent& event)
@@ -611,22 +1342,59 @@ class TeleAddressWindow : public wxFrame
         wxString companyPhone = companyPhoneCtrl_->GetValue();
         wxString companyRif = companyRifCtrl_->GetValue();
         wxString newEvent = newEventCtrl_->GetValue();
+        ContactEvent addedEvent;
+        addedEvent.start = eventDatePicker_->GetValue();
+        int hour, minute, second;
+        eventTimePicker_->GetTime(&hour, &minute, &second);
+        addedEvent.start.SetHour(static_cast<wxDateTime::wxDateTime_t>(hour)).SetMinute(static_cast<wxDateTime::wxDateTime_t>(minute));
+        addedEvent.title = newEvent.ToStdString();
+        addedEvent.notes = eventNotesCtrl_->GetValue().ToStdString();
         bool belongsToCompany = companyCheckBox_->GetValue();
         bool hasEvent = eventCheckBox_->GetValue();
         ContactNode* contact;
 
         if(!firstName.empty() && !lastName.empty() && !phoneNumber.empty() && !address.empty())
         {
+            // Companies are keyed by RIF, so a mistyped one would make a new company
+            std::string normalizedRif;
+            if(belongsToCompany && !companyRif.empty() && !NormalizeRif(companyRif.ToStdString(), normalizedRif))
+            {
+                wxMessageBox(wxString::Format("%s is not a valid RIF.", companyRif), "Error", wxOK | wxICON_ERROR);
+                return;
+            }
+
+            // Warn before a second contact gets the same phone number
+            ContactNode* editedContact = nullptr;
+            if(editMode_ && contactList_->GetSelection().IsOk())
+            {
+                editedContact = contactModel_->GetContact(contactList_->GetSelection());
+            }
+            ContactNode* duplicate = contactStore_.FindPhoneDuplicate(phoneNumber.ToStdString(), editedContact);
+            if(duplicate)
+            {
+                wxString question = wxString::Format("%s already has the phone number %s.\nSave this contact anyway?", wxString(duplicate->getFullName()), ToWxString(duplicate->getPhoneNumber()));
+                if(wxMessageBox(question, "Duplicate phone number", wxYES_NO | wxICON_WARNING) != wxYES)
+                {
+                    return;
+                }
+            }
+
             if(editMode_)
             {
-                // Get the contact selected in the tree
-                wxTreeItemId itemId = contactTree_->GetSelection();
-                if(itemId.IsOk())
+                // Get the contact selected in the list
+                wxDataViewItem item = contactList_->GetSelection();
+                if(item.IsOk())
                 {
-                    ContactNodeData* contactData = dynamic_cast<ContactNodeData*>(contactTree_->GetItemData(itemId));
-                    if(contactData)
+                    contact = contactModel_->GetContact(item);
+                    if(contact)
                     {
-                        contact = contactData->GetContactNode();
+                        completions_.RemoveContact(contact);
+                        bool companyChanged = false;
+                        std::string oldCompanyName;
+
+                        // Where the contact is listed before a new name can move it
+                        size_t row = static_cast<size_t>(contactStore_.FindRow(contact));
+                        int group = contactModel_->GroupOf(contact);
 
                         //  Update the existing contact's data
                         contact->setFirstName(firstName.ToStdString());
@@ -637,9 +1405,8 @@ class TeleAddressWindow : public wxFrame
                         {
                             if(!companyName.empty() && !companyPhone.empty() && !companyRif.empty())
                             {
-                                contact->setCompanyName(companyName.ToStdString());
-                                contact->setCompanyPhone(companyPhone.ToStdString());
-                                contact->setCompanyRif(companyRif.ToStdString());
+                                oldCompanyName = CompanyNameOf(companyRif.ToStdString());
+                                companyChanged = contactStore_.SetCompany(contact, companyName.ToStdString(), companyPhone.ToStdString(), companyRif.ToStdString());
                             }
                             else
                             {
@@ -651,7 +1418,15 @@ class TeleAddressWindow : public wxFrame
                         {
                             if(!newEvent.empty())
                             {
-                                contact->setNewEvent(newEvent.ToStdString());
+                                // The event joins the ones the contact has; free text
+                                // written by older versions is kept in its notes
+                                std::vector<ContactEvent> events;
+                                if(!ParseContactEvents(contact->getNewEvent(), events) && !contact->getNewEvent().empty() && addedEvent.notes.empty())
+                                {
+                                    addedEvent.notes = contact->getNewEvent();
+                                }
+                                events.push_back(addedEvent);
+                                contact->setNewEvent(FormatContactEvents(events));
                             }
                             else
                             {
@@ -659,36 +1434,78 @@ class TeleAddressWindow : public wxFrame
                             }
                         }
 
-                        // Update the contact data in the tree
-                        contactTree_->SetItemText(itemId, contact->getFullName());
+                        // Update the contact data in the list, moving it if the name changed
+                        if(contactStore_.Reposition(row) != row || contactModel_->GroupOf(contact) != group)
+                        {
+                            contactModel_->ContactMoved(contact, group);
+                            ShowContact(contact);
+                        }
+                        else
+                        {
+                            contactModel_->ContactChanged(contact);
+                        }
+                        searchIndex_.UpdateContact(contact);
+                        completions_.AddContact(contact);
+                        journal_.RecordUpdate(contact);
+                        if(eventsWindow_)
+                        {
+                            eventsWindow_->RefreshEvents();
+                        }
+                        if(companyChanged)
+                        {
+                            RefreshCompanyContacts(contact->getCompanyId(), oldCompanyName, contact);
+                        }
+                        if(searchWindow_)
+                        {
+                            searchWindow_->RefreshResults();
+                        }
                     }
                 }
                 buttonAdd_->SetLabel("Add");
             }
             else
             {
+                // Creating the contact can name a known company that had no name yet
+                std::string oldCompanyName = CompanyNameOf(companyRif.ToStdString());
+
                 // Create the new contact node
                 if(!belongsToCompany && !hasEvent)
                 {
-                    contact = new ContactNode(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), "", "", "", "");
+                    contact = contactStore_.CreateContact(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), "", "", "", "");
                 }
                 else if (belongsToCompany && !hasEvent)
                 {
-                    contact = new ContactNode(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), companyName.ToStdString(), companyPhone.ToStdString(), companyRif.ToStdString(), "");
+                    contact = contactStore_.CreateContact(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), companyName.ToStdString(), companyPhone.ToStdString(), companyRif.ToStdString(), "");
                 }
                 else
                 {
-                    contact = new ContactNode(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), companyName.ToStdString(), companyPhone.ToStdString(), companyRif.ToStdString(), newEvent.ToStdString());
+                    contact = contactStore_.CreateContact(firstName.ToStdString(), lastName.ToStdString(), phoneNumber.ToStdString(), address.ToStdString(), companyName.ToStdString(), companyPhone.ToStdString(), companyRif.ToStdString(), FormatContactEvents(std::vector<ContactEvent>(1, addedEvent)));
                 }
-                
 
-                // Insert the contact as a child of the tree root
-                wxTreeItemId rootItemId = contactTree_->GetRootItem();
-                wxTreeItemId newItemId = contactTree_->AppendItem(rootItemId, contact->getFullName(), -1, -1, new ContactNodeData(contact));
-                //Sort the children of the root alphabetically
-                contactTree_->SortChildren(rootItemId);
+                // A known company takes the name and phone typed, before the record is journaled
+                bool companyChanged = belongsToCompany && contactStore_.UpdateCompany(companyRif.ToStdString(), companyName.ToStdString(), companyPhone.ToStdString());
+
+                // Insert the contact at its alphabetical position
+                contact->setId(journal_.NextId());
+                journal_.RecordAdd(contact);
+                contactStore_.Add(contact);
+                contactModel_->ContactAdded(contact);
+                searchIndex_.AddContact(contact);
+                completions_.AddContact(contact);
+                if(eventsWindow_)
+                {
+                    eventsWindow_->RefreshEvents();
+                }
+                if(companyChanged)
+                {
+                    RefreshCompanyContacts(contact->getCompanyId(), oldCompanyName, contact);
+                }
+                if(searchWindow_)
+                {
+                    searchWindow_->RefreshResults();
+                }
                 // Select the new contact
-                contactTree_->SelectItem(newItemId);
+                ShowContact(contact);
             }
 
             // Clear input fields
@@ -700,6 +1517,7 @@ class TeleAddressWindow : public wxFrame
             companyPhoneCtrl_->Clear();
             companyRifCtrl_->Clear();
             newEventCtrl_->Clear();
+            eventNotesCtrl_->Clear();
 
             editMode_ = false;
 
@@ -714,27 +1532,28 @@ class TeleAddressWindow : public wxFrame
 
     void OnEditButtonClicked(wxCommandEvent& event)
     {
-        // Get the contact selected in the tree
-        wxTreeItemId itemId = contactTree_->GetSelection();
+        // Get the contact selected in the list
+        wxDataViewItem item = contactList_->GetSelection();
         ContactNode* contact;
 
-        if (itemId.IsOk())
+        if (item.IsOk())
         {
-            ContactNodeData* contactData = dynamic_cast<ContactNodeData*>(contactTree_->GetItemData(itemId));
-            if (contactData)
+            contact = contactModel_->GetContact(item);
+            if (contact)
             {
-                contact = contactData->GetContactNode();
                 
 
                 // Load contact data in input fields
-                textCtrlFirstName_->SetValue(contact->getFirstName());
-                textCtrlLastName_->SetValue(contact->getLastName());
-                textCtrlPhoneNumber_->SetValue(contact->getPhoneNumber());
-                textCtrlAddress_->SetValue(contact->getAddress());
-                companyNameCtrl_->SetValue(contact->getCompanyName());
-                companyPhoneCtrl_->SetValue(contact->getCompanyPhone());
-                companyRifCtrl_->SetValue(contact->getCompanyRif());
-                newEventCtrl_->SetValue(contact->getNewEvent());
+                textCtrlFirstName_->SetValue(ToWxString(contact->getFirstName()));
+                textCtrlLastName_->SetValue(ToWxString(contact->getLastName()));
+                textCtrlPhoneNumber_->SetValue(ToWxString(contact->getPhoneNumber()));
+                textCtrlAddress_->SetValue(ToWxString(contact->getAddress()));
+                companyNameCtrl_->SetValue(ToWxString(contact->getCompanyName()));
+                companyPhoneCtrl_->SetValue(ToWxString(contact->getCompanyPhone()));
+                companyRifCtrl_->SetValue(ToWxString(contact->getCompanyRif()));
+                // The event box adds an event to the ones the contact has
+                newEventCtrl_->Clear();
+                eventNotesCtrl_->Clear();
                 if(!companyNameCtrl_->IsEmpty())
                 {
                     companyCheckBox_->SetValue(true);
@@ -749,20 +1568,9 @@ class TeleAddressWindow : public wxFrame
                     companyCheckBox_->SetValue(false);
                     companySizer_->Show(false);
                 }
-                if(!newEventCtrl_->IsEmpty())
-                {
-                    eventCheckBox_->SetValue(true);
-                    // Show or hide the eventSizer_
-                    eventSizer_->Show(true);
-
-                    // Rearrange the window layout
-                    Layout();
-                }
-                else
-                {
-                    eventCheckBox_->SetValue(false);
-                    eventSizer_->Show(false);
-                }
+                eventCheckBox_->SetValue(false);
+                eventSizer_->Show(false);
+                Layout();
                 
 
                 // Set the Edit Mode and buttonAdd_ value update
@@ -774,37 +1582,38 @@ class TeleAddressWindow : public wxFrame
 
     void OnDeleteButtonClicked(wxCommandEvent& event)
     {
-        // Get the contact selected in the tree
-        wxTreeItemId itemId = contactTree_->GetSelection();
-        if (itemId.IsOk())
+        // Get the contact selected in the list
+        wxDataViewItem item = contactList_->GetSelection();
+        if (item.IsOk())
         {
             // Confirm the contact's deletion
             int answer = wxMessageBox("Are you sure you want to delete this contact?", "Confirm Deletion", wxYES_NO | wxICON_QUESTION);
             if (answer == wxYES)
             {
                 // Delete the contact
-                contactTree_->Delete(itemId);
-            }
-        }
-
-        //loops through the contacts stored in the tree and writes their data to a file
-        std::ofstream outputFile(fileName);
-        if(outputFile.is_open())
-        {
-            wxTreeItemIdValue cookie;
-            wxTreeItemId rootItemId = contactTree_->GetRootItem();
-            wxTreeItemId itemId = contactTree_->GetFirstChild(rootItemId, cookie);
-            while (itemId.IsOk())
-            {
-                ContactNodeData* contactData = dynamic_cast<ContactNodeData*>(contactTree_->GetItemData(itemId));
-                if(contactData)
+                ContactNode* contact = contactModel_->GetContact(item);
+                if(contact)
                 {
-                    ContactNode* contact = contactData->GetContactNode();
-                    outputFile << contact->getFirstName() << "," << contact->getLastName() << "," << contact->getPhoneNumber() << "," << contact->getAddress() << "," << contact->getCompanyName() << "," << contact->getCompanyPhone() << "," << contact->getCompanyRif() << "," << contact->getNewEvent() << "\n";
+                    searchIndex_.RemoveContact(contact);
+                    completions_.RemoveContact(contact);
+                    if(searchWindow_)
+                    {
+                        searchWindow_->RemoveContact(contact);
+                    }
+
+                    journal_.RecordDelete(contact);
+
+                    int group = contactModel_->GroupOf(contact);
+                    contactStore_.Remove(static_cast<size_t>(contactStore_.FindRow(contact)));
+                    contactModel_->ContactRemoved(contact, group);
+                    if(eventsWindow_)
+                    {
+                        eventsWindow_->RefreshEvents();
+                    }
+
+                    SaveContactsToFile();
                 }
-                itemId = contactTree_->GetNextChild(rootItemId, cookie);
             }
-            outputFile.close();
         }
 
     }
@@ -814,8 +1623,13 @@ class TeleAddressWindow : public wxFrame
     {
         if(!searchWindow_)
         {
+            if(searchIndexStale_)
+            {
+                RebuildSearchIndex();
+            }
+
             //create search window
-            searchWindow_ = new SearchWindow("Search Contacts", wxPoint(50, 50), wxSize(400, 200));
+            searchWindow_ = new SearchWindow("Search Contacts", wxPoint(50, 50), wxSize(400, 200), &searchIndex_);
             searchWindow_->Connect(wxEVT_CLOSE_WINDOW, wxCloseEventHandler(TeleAddressWindow::OnSearchWindowClosed), nullptr, this);
             searchWindow_->Show();
         }
@@ -831,12 +1645,92 @@ class TeleAddressWindow : public wxFrame
     void OnSearchWindowClosed(wxCloseEvent& event)
     {
         //Delete the search window instance when closing it
+        searchWindow_->StopSearching();
         searchWindow_->Destroy();
         searchWindow_ = nullptr;
     }
 
+    void OnEventsButtonClicked(wxCommandEvent& event)
+    {
+        if(!eventsWindow_)
+        {
+            eventsWindow_ = new EventsWindow("Events", wxPoint(50, 50), wxSize(800, 400), &contactStore_.GetEvents(), [this](ContactNode* contact, size_t ordinal)
+            {
+                DeleteEvent(contact, ordinal);
+            });
+            eventsWindow_->Connect(wxEVT_CLOSE_WINDOW, wxCloseEventHandler(TeleAddressWindow::OnEventsWindowClosed), nullptr, this);
+        }
+        eventsWindow_->Show();
+        eventsWindow_->Iconize(false);
+        eventsWindow_->Raise();
+    }
+
+    void OnReminderTimer(wxTimerEvent& event)
+    {
+        std::vector<EventEntry> due;
+        contactStore_.AdvanceReminders(wxDateTime::GetTimeNow(), due);
+        if(due.empty())
+        {
+            return;
+        }
+
+        wxString message;
+        for (const EventEntry& entry : due)
+        {
+            std::vector<ContactEvent> events;
+            if(!ParseContactEvents(entry.contact->getNewEvent(), events) || entry.ordinal >= events.size())
+            {
+                continue;
+            }
+            const ContactEvent& contactEvent = events[entry.ordinal];
+            if(!message.empty())
+            {
+                message += "\n";
+            }
+            message += wxString::Format("%s, %s: %s", contactEvent.start.Format("%Y-%m-%d %H:%M"), wxString(entry.contact->getFullName()), ToWxString(contactEvent.title));
+        }
+
+        // A newer reminder replaces the one still shown
+        reminderNotification_.reset(new wxNotificationMessage("Upcoming events", message, this));
+        reminderNotification_->Show(wxNotificationMessage::Timeout_Never);
+    }
+
+    void OnEventsWindowClosed(wxCloseEvent& event)
+    {
+        eventsWindow_->Destroy();
+        eventsWindow_ = nullptr;
+    }
+
+    // Removes one event of a stored contact, as listed by the events window
+    void DeleteEvent(ContactNode* contact, size_t ordinal)
+    {
+        int row = contactStore_.FindRow(contact);
+        std::vector<ContactEvent> events;
+        if(row < 0 || !ParseContactEvents(contact->getNewEvent(), events) || ordinal >= events.size())
+        {
+            return;
+        }
+        events.erase(events.begin() + ordinal);
+        contact->setNewEvent(FormatContactEvents(events));
+        contactStore_.Reposition(static_cast<size_t>(row));
+        contactModel_->ContactChanged(contact);
+        searchIndex_.UpdateContact(contact);
+        journal_.RecordUpdate(contact);
+        eventsWindow_->RefreshEvents();
+        if(searchWindow_)
+        {
+            searchWindow_->RefreshResults();
+        }
+        SaveContactsToFile();
+    }
+
     private:
-        wxTreeCtrl* contactTree_;
+        // The reminder wheel moves in one-second ticks
+        static const int REMINDER_TICK_MS = 1000;
+
+        wxDataViewCtrl* contactList_;
+        ContactTreeModel* contactModel_;
+        ContactStore contactStore_;
         wxTextCtrl* textCtrlFirstName_;
         wxTextCtrl* textCtrlLastName_;
         wxTextCtrl* textCtrlPhoneNumber_;
@@ -849,15 +1743,91 @@ class TeleAddressWindow : public wxFrame
         wxTextCtrl* companyPhoneCtrl_;
         wxTextCtrl* companyRifCtrl_;
         wxTextCtrl* newEventCtrl_;
+        wxDatePickerCtrl* eventDatePicker_;
+        wxTimePickerCtrl* eventTimePicker_;
+        wxTextCtrl* eventNotesCtrl_;
         wxButton* buttonAdd_;
         wxButton* buttonEdit_;
         wxButton* buttonDelete_;
         wxButton* buttonOpenSearch_;
+        wxButton* buttonOpenEvents_;
         wxButton* buttonExport_;
         wxButton* buttonImport_;
-        SearchWindow* searchWindow_;
+        SearchWindow* searchWindow_ = nullptr;
+        EventsWindow* eventsWindow_ = nullptr;
+        wxTimer reminderTimer_{this};
+        std::unique_ptr<wxNotificationMessage> reminderNotification_;
+        SearchIndex searchIndex_;
+        bool searchIndexStale_ = true;
         bool editMode_;
         std::string fileName = "contacts.txt";
+        ContactJournal journal_{fileName};
+        ContactCompletions completions_{contactStore_};
+
+        // Runs work on a background thread behind a modal progress dialog whose
+        // Cancel button sets progress.cancelled. Returns false if it was cancelled.
+        // If poll is given, the GUI thread calls it until it returns false
+        // with the work finished, consuming what the work hands over; the
+        // dialog then has no Cancel button since the store is being changed.
+        bool RunWithProgress(const wxString& title, JobProgress& progress, bool countsBytes, const std::function<void()>& work, const std::function<bool()>& poll = nullptr)
+        {
+            const int PROGRESS_RANGE = 1000;
+            const int POLL_INTERVAL_MS = 50;
+
+            BackgroundJob* job = new BackgroundJob(work);
+            if (job->Run() != wxTHREAD_NO_ERROR)
+            {
+                // No thread available, run it here without a dialog
+                delete job;
+                work();
+                while (poll && poll())
+                {
+                }
+                return !progress.IsCancelled();
+            }
+
+            wxProgressDialog dialog(title, "Starting...", PROGRESS_RANGE, this, wxPD_APP_MODAL | (poll ? 0 : wxPD_CAN_ABORT) | wxPD_ELAPSED_TIME | wxPD_REMAINING_TIME);
+            wxAppProgressIndicator taskbarProgress(this, PROGRESS_RANGE);
+            wxStopWatch stopWatch;
+            while (true)
+            {
+                // Checked before polling so nothing handed over at the end is missed
+                bool finished = job->IsFinished();
+                if (!(poll && poll()))
+                {
+                    if (finished)
+                    {
+                        break;
+                    }
+                    wxMilliSleep(POLL_INTERVAL_MS);
+                }
+
+                std::uint64_t done = progress.done;
+                std::uint64_t total = progress.total;
+                int value = total > 0 ? static_cast<int>(std::min<std::uint64_t>(done, total) * (PROGRESS_RANGE - 1) / total) : 0;
+                double seconds = std::max(stopWatch.Time(), 1L) / 1000.0;
+                wxString message;
+                if (countsBytes)
+                {
+                    const double MEGABYTE = 1024.0 * 1024.0;
+                    message = wxString::Format("%.1f of %.1f MB, %.1f MB/s", done / MEGABYTE, total / MEGABYTE, done / MEGABYTE / seconds);
+                }
+                else
+                {
+                    message = wxString::Format("%llu of %llu contacts, %.0f contacts/s", static_cast<unsigned long long>(done), static_cast<unsigned long long>(total), done / seconds);
+                }
+
+                // The job notices the flag at its next check and finishes early
+                if (!progress.IsCancelled() && !dialog.Update(value, message))
+                {
+                    progress.cancelled = true;
+                }
+                taskbarProgress.SetValue(value);
+            }
+            job->Wait();
+            delete job;
+            return !progress.IsCancelled();
+        }
 };
 
 
@@ -888,41 +1858,7 @@ class TeleAddressApp : public wxApp
             TeleAddressWindow* mainWindow = new TeleAddressWindow("TeleAddress", wxPoint(50, 50), wxSize(800, 600));
             mainWindow->Show(true);
 
-            std::vector<ContactNodeData*> contactNodes;
-            std::ifstream inputFile(fileName);
-            std::string line;
-            while(std::getline(inputFile, line))
-            {
-                std::istringstream iss(line);
-                std::string firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent;
-
-                if(std::getline(iss, firstName, ',') && std::getline(iss, lastName, ',') && std::getline(iss, phoneNumber, ',') && std::getline(iss, address, ',') && std::getline(iss, companyName, ',') && std::getline(iss, companyPhone, ',') && std::getline(iss, companyRif, ',') && std::getline(iss, newEvent, ','))
-                {
-                    ContactNode* contact = new ContactNode(firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent);
-                    contactNodes.push_back(new ContactNodeData(contact));
-                }
-                else
-                {
-                    ContactNode* contact = new ContactNode(firstName, lastName, phoneNumber, address, companyName, companyPhone, companyRif, newEvent);
-                    contactNodes.push_back(new ContactNodeData(contact));
-                }
-            }
-            inputFile.close();
-
-            // Sort contacts alphabetically
-            std::sort(contactNodes.begin(), contactNodes.end(), [](const ContactNodeData* a, const ContactNodeData* b) 
-            {
-            return a->GetContactNode()->getFullName() < b->GetContactNode()->getFullName();
-            });
-
-            // Add the sorted contacts to the tree
-            wxTreeItemId rootItemId = mainWindow->GetContactTree()->GetRootItem();
-            for (const auto& contactData : contactNodes)
-            {
-                ContactNode* contact = contactData->GetContactNode();
-                wxString fullName(contact->getFullName());
-                mainWindow->GetContactTree()->AppendItem(rootItemId, fullName, -1, -1, contactData);
-            }
+            mainWindow->LoadContactsFromFile();
 
             return true;
         }
@@ -0,0 +1,187 @@
+#ifndef PHONEINDEX_H
+#define PHONEINDEX_H
+
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "contactnode.h"
+
+// Country code assumed for numbers written without one
+const std::uint64_t DEFAULT_COUNTRY_CODE = 58;
+
+// Digits of a national number with its area code but without the trunk 0
+const size_t NATIONAL_NUMBER_DIGITS = 10;
+
+// E.164 numbers have at most 15 digits
+const size_t MAX_PHONE_DIGITS = 15;
+
+// Reduces a phone number to an integer key equal for every way of writing
+// it. Formatting is dropped and anything after the first letter (an
+// extension) is ignored. Numbers starting with + or 00 already carry their
+// country code; a leading trunk 0, or a bare national number, gets the
+// default country code. Shorter local numbers are kept as written. The digit
+// count sits in the top byte so leading zeros stay significant.
+// Returns false if there are no digits or too many.
+inline bool NormalizePhoneNumber(std::string_view phoneNumber, std::uint64_t& key)
+{
+    char digits[MAX_PHONE_DIGITS + 1];
+    size_t count = 0;
+    bool international = false;
+    for (char c : phoneNumber)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            if (count == MAX_PHONE_DIGITS + 1)
+            {
+                return false;
+            }
+            digits[count++] = c;
+        }
+        else if (c == '+' && count == 0)
+        {
+            international = true;
+        }
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        {
+            break;
+        }
+    }
+
+    const char* start = digits;
+    std::uint64_t countryCode = 0;
+    if (!international && count >= 2 && digits[0] == '0' && digits[1] == '0')
+    {
+        start += 2;
+    }
+    else if (!international && count >= 1 && digits[0] == '0')
+    {
+        start += 1;
+        countryCode = DEFAULT_COUNTRY_CODE;
+    }
+    else if (!international && count == NATIONAL_NUMBER_DIGITS)
+    {
+        countryCode = DEFAULT_COUNTRY_CODE;
+    }
+
+    size_t length = digits + count - start;
+    std::uint64_t value = countryCode;
+    size_t totalLength = length;
+    for (std::uint64_t code = countryCode; code > 0; code /= 10)
+    {
+        totalLength++;
+    }
+    if (length == 0 || totalLength > MAX_PHONE_DIGITS)
+    {
+        return false;
+    }
+    for (const char* digit = start; digit < digits + count; digit++)
+    {
+        value = value * 10 + static_cast<std::uint64_t>(*digit - '0');
+    }
+    key = (static_cast<std::uint64_t>(totalLength) << 56) | value;
+    return true;
+}
+
+// Hash index from normalized phone number to the contacts using it, for
+// exact lookups and duplicate checks in constant time. Remembers the key each
+// contact was indexed under, so a contact can be updated after its phone
+// number was edited.
+class PhoneIndex
+{
+    public:
+        void Clear()
+        {
+            contactsByKey_.clear();
+            keys_.clear();
+        }
+
+        void Reserve(size_t count)
+        {
+            contactsByKey_.reserve(count);
+            keys_.reserve(count);
+        }
+
+        void AddContact(ContactNode* contact)
+        {
+            std::uint64_t key;
+            if (NormalizePhoneNumber(contact->getPhoneNumber(), key))
+            {
+                contactsByKey_[key].push_back(contact);
+                keys_[contact] = key;
+            }
+        }
+
+        void RemoveContact(ContactNode* contact)
+        {
+            auto indexed = keys_.find(contact);
+            if (indexed == keys_.end())
+            {
+                return;
+            }
+
+            auto entry = contactsByKey_.find(indexed->second);
+            std::vector<ContactNode*>& contacts = entry->second;
+            for (size_t i = 0; i < contacts.size(); i++)
+            {
+                if (contacts[i] == contact)
+                {
+                    contacts[i] = contacts.back();
+                    contacts.pop_back();
+                    break;
+                }
+            }
+            if (contacts.empty())
+            {
+                contactsByKey_.erase(entry);
+            }
+            keys_.erase(indexed);
+        }
+
+        void UpdateContact(ContactNode* contact)
+        {
+            RemoveContact(contact);
+            AddContact(contact);
+        }
+
+        // Contacts whose phone number is the same as the given one once normalized
+        std::vector<ContactNode*> Find(std::string_view phoneNumber) const
+        {
+            std::uint64_t key;
+            if (!NormalizePhoneNumber(phoneNumber, key))
+            {
+                return std::vector<ContactNode*>();
+            }
+            auto entry = contactsByKey_.find(key);
+            return entry == contactsByKey_.end() ? std::vector<ContactNode*>() : entry->second;
+        }
+
+        // A contact other than except already using the phone number, or null
+        ContactNode* FindDuplicate(std::string_view phoneNumber, const ContactNode* except = nullptr) const
+        {
+            std::uint64_t key;
+            if (!NormalizePhoneNumber(phoneNumber, key))
+            {
+                return nullptr;
+            }
+            auto entry = contactsByKey_.find(key);
+            if (entry == contactsByKey_.end())
+            {
+                return nullptr;
+            }
+            for (ContactNode* contact : entry->second)
+            {
+                if (contact != except)
+                {
+                    return contact;
+                }
+            }
+            return nullptr;
+        }
+
+    private:
+        std::unordered_map<std::uint64_t, std::vector<ContactNode*>> contactsByKey_;
+        std::unordered_map<const ContactNode*, std::uint64_t> keys_;
+};
+
+#endif // PHONEINDEX_H
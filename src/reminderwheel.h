@@ -0,0 +1,324 @@
+#ifndef REMINDERWHEEL_H
+#define REMINDERWHEEL_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "contactnode.h"
+#include "contactevents.h"
+
+// Reminders of the coming events of the stored contacts, one per event,
+// falling due LEAD_SECONDS before it starts. Kept in a hierarchical timing
+// wheel with one-second ticks: four levels of 64 slots cover about 194 days,
+// later reminders wait in the last level and are placed again when it turns.
+// Scheduling and cancelling a reminder unlinks or links one list node, and a
+// reminder is moved down a level at most three times before it fires, so
+// every operation is constant time amortized. Nothing is ever scanned
+// beyond the slots the clock passes.
+// A reminder that fired stays in the wheel, marked fired, until its event
+// starts, so an edit of its contact that keeps the event does not raise it
+// again.
+class ReminderWheel
+{
+    public:
+        // How long before an event its reminder is due
+        static const std::int64_t LEAD_SECONDS = 15 * 60;
+
+        explicit ReminderWheel(std::int64_t now) : now_(now), freeNodes_(NONE), freeCount_(0)
+        {
+            for (std::uint32_t& head : slots_)
+            {
+                head = NONE;
+            }
+        }
+
+        // Drops every reminder, keeping the clock
+        void Clear()
+        {
+            nodes_.clear();
+            freeNodes_ = NONE;
+            freeCount_ = 0;
+            remindersByContact_.clear();
+            for (std::uint32_t& head : slots_)
+            {
+                head = NONE;
+            }
+        }
+
+        // Schedules a reminder for each event parsed from the contact's event
+        // field that has not started yet, replacing those it had. An event
+        // already scheduled with the same start keeps its reminder, fired or
+        // not; a new one already due fires at the next tick.
+        void UpdateContact(ContactNode* contact, const std::vector<ContactEvent>& events)
+        {
+            std::vector<std::uint32_t> previous;
+            auto scheduled = remindersByContact_.find(contact);
+            if (scheduled != remindersByContact_.end())
+            {
+                previous.swap(scheduled->second);
+                remindersByContact_.erase(scheduled);
+            }
+
+            std::vector<std::uint32_t>* reminders = nullptr;
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                std::int64_t start = EventIndex::TimeKey(events[i].start) / 1000;
+                if (start <= now_)
+                {
+                    continue;
+                }
+                if (!reminders)
+                {
+                    reminders = &remindersByContact_[contact];
+                }
+
+                std::uint32_t index = NONE;
+                for (std::uint32_t& kept : previous)
+                {
+                    if (kept != NONE && nodes_[kept].start == start)
+                    {
+                        index = kept;
+                        kept = NONE;
+                        break;
+                    }
+                }
+                if (index == NONE)
+                {
+                    index = AllocateNode();
+                    Node& node = nodes_[index];
+                    node.start = start;
+                    node.due = start - LEAD_SECONDS;
+                    node.contact = contact;
+                    node.fired = false;
+                    Place(index, now_ + 1);
+                }
+                nodes_[index].ordinal = static_cast<std::uint32_t>(i);
+                reminders->push_back(index);
+            }
+
+            for (std::uint32_t index : previous)
+            {
+                if (index != NONE)
+                {
+                    Unlink(index);
+                    FreeNode(index);
+                }
+            }
+        }
+
+        void RemoveContact(ContactNode* contact)
+        {
+            auto scheduled = remindersByContact_.find(contact);
+            if (scheduled == remindersByContact_.end())
+            {
+                return;
+            }
+            for (std::uint32_t index : scheduled->second)
+            {
+                Unlink(index);
+                FreeNode(index);
+            }
+            remindersByContact_.erase(scheduled);
+        }
+
+        // Moves the clock to now, appending the reminders that fell due
+        void Advance(std::int64_t now, std::vector<EventEntry>& fired)
+        {
+            if (now - now_ >= WHEEL_SPAN)
+            {
+                // Slept longer than the wheel covers, place everything again
+                std::vector<std::uint32_t> pending;
+                for (std::uint32_t& head : slots_)
+                {
+                    for (std::uint32_t index = head; index != NONE; index = nodes_[index].next)
+                    {
+                        pending.push_back(index);
+                    }
+                    head = NONE;
+                }
+                now_ = now;
+                for (std::uint32_t index : pending)
+                {
+                    if (nodes_[index].due <= now_)
+                    {
+                        Fire(index, fired);
+                    }
+                    else
+                    {
+                        Place(index, now_ + 1);
+                    }
+                }
+                return;
+            }
+
+            while (now_ < now)
+            {
+                now_++;
+
+                // Each level turning over brings the next slot of the level above down
+                for (int level = 1; level < LEVELS && ((now_ >> (SLOT_BITS * (level - 1))) & SLOT_MASK) == 0; level++)
+                {
+                    std::uint32_t& head = slots_[level * SLOTS + ((now_ >> (SLOT_BITS * level)) & SLOT_MASK)];
+                    std::uint32_t index = head;
+                    head = NONE;
+                    while (index != NONE)
+                    {
+                        std::uint32_t next = nodes_[index].next;
+                        Place(index, now_);
+                        index = next;
+                    }
+                }
+
+                std::uint32_t& head = slots_[now_ & SLOT_MASK];
+                std::uint32_t index = head;
+                head = NONE;
+                while (index != NONE)
+                {
+                    std::uint32_t next = nodes_[index].next;
+                    Fire(index, fired);
+                    index = next;
+                }
+            }
+        }
+
+        // Reminders scheduled, counting fired ones whose event has not started
+        size_t Size() const
+        {
+            return nodes_.size() - freeCount_;
+        }
+
+    private:
+        static const int LEVELS = 4;
+        static const int SLOT_BITS = 6;
+        static const int SLOTS = 1 << SLOT_BITS;
+        static const std::int64_t SLOT_MASK = SLOTS - 1;
+        static const std::int64_t WHEEL_SPAN = std::int64_t(1) << (SLOT_BITS * LEVELS);
+        static const std::uint32_t NONE = 0xFFFFFFFF;
+
+        // A scheduled reminder, linked into the list of its slot
+        struct Node
+        {
+            std::int64_t start;
+            std::int64_t due;
+            ContactNode* contact;
+            std::uint32_t ordinal;
+            std::uint32_t slot;
+            std::uint32_t previous;
+            std::uint32_t next;
+
+            // Reported already, due again only to be dropped when its event starts
+            bool fired;
+        };
+
+        std::int64_t now_;
+        std::vector<Node> nodes_;
+        std::uint32_t freeNodes_;
+        size_t freeCount_;
+        std::uint32_t slots_[LEVELS * SLOTS];
+        std::unordered_map<const ContactNode*, std::vector<std::uint32_t>> remindersByContact_;
+
+        std::uint32_t AllocateNode()
+        {
+            if (freeNodes_ != NONE)
+            {
+                std::uint32_t index = freeNodes_;
+                freeNodes_ = nodes_[index].next;
+                freeCount_--;
+                return index;
+            }
+            nodes_.emplace_back();
+            return static_cast<std::uint32_t>(nodes_.size() - 1);
+        }
+
+        void FreeNode(std::uint32_t index)
+        {
+            nodes_[index].contact = nullptr;
+            nodes_[index].next = freeNodes_;
+            freeNodes_ = index;
+            freeCount_++;
+        }
+
+        // Links a node into the slot of its due tick, not earlier than earliest.
+        // The level is the first whose slots reach that far; a tick beyond the
+        // wheel goes to the last slot it reaches and is placed again from there.
+        void Place(std::uint32_t index, std::int64_t earliest)
+        {
+            Node& node = nodes_[index];
+            std::int64_t tick = node.due < earliest ? earliest : node.due;
+            std::int64_t delta = tick - now_;
+            if (delta >= WHEEL_SPAN)
+            {
+                tick = now_ + WHEEL_SPAN - 1;
+                delta = WHEEL_SPAN - 1;
+            }
+
+            int level = 0;
+            while (level < LEVELS - 1 && delta >= (std::int64_t(1) << (SLOT_BITS * (level + 1))))
+            {
+                level++;
+            }
+            node.slot = static_cast<std::uint32_t>(level * SLOTS + ((tick >> (SLOT_BITS * level)) & SLOT_MASK));
+
+            std::uint32_t& head = slots_[node.slot];
+            node.previous = NONE;
+            node.next = head;
+            if (head != NONE)
+            {
+                nodes_[head].previous = index;
+            }
+            head = index;
+        }
+
+        void Unlink(std::uint32_t index)
+        {
+            Node& node = nodes_[index];
+            if (node.previous != NONE)
+            {
+                nodes_[node.previous].next = node.next;
+            }
+            else
+            {
+                slots_[node.slot] = node.next;
+            }
+            if (node.next != NONE)
+            {
+                nodes_[node.next].previous = node.previous;
+            }
+        }
+
+        // Reports a node already taken out of its slot and keeps it, marked
+        // fired, until its event starts; a fired node is freed instead
+        void Fire(std::uint32_t index, std::vector<EventEntry>& fired)
+        {
+            Node& node = nodes_[index];
+            if (!node.fired)
+            {
+                fired.push_back(EventEntry{node.start * 1000, node.contact, node.ordinal});
+                if (node.start > now_)
+                {
+                    node.fired = true;
+                    node.due = node.start;
+                    Place(index, now_ + 1);
+                    return;
+                }
+            }
+
+            std::vector<std::uint32_t>& reminders = remindersByContact_[node.contact];
+            for (size_t i = 0; i < reminders.size(); i++)
+            {
+                if (reminders[i] == index)
+                {
+                    reminders[i] = reminders.back();
+                    reminders.pop_back();
+                    break;
+                }
+            }
+            if (reminders.empty())
+            {
+                remindersByContact_.erase(node.contact);
+            }
+            FreeNode(index);
+        }
+};
+
+#endif // REMINDERWHEEL_H
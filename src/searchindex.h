@@ -0,0 +1,609 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include "contactnode.h"
+#include "textfold.h"
+
+// Matches of one query, kept by the caller so the next query can refine them
+struct SearchResult
+{
+    std::string query;
+    std::vector<ContactNode*> contacts;
+    std::uint64_t version = 0;
+    bool valid = false;
+
+    // Ranked fuzzy name matches rather than substring matches
+    bool fuzzy = false;
+};
+
+// In-memory trigram index over a folded shadow copy of the record line of
+// every contact: lower cased, accents stripped and ñ read as n, rebuilt
+// whenever the contact changes. A query is folded once and then matched with
+// plain byte compares, so "jose" finds "José" and "MARIA" finds "María".
+// Each trigram keeps a sorted posting list of document ids, so a query is
+// answered by intersecting the lists of its trigrams and verifying the
+// few remaining candidates, without touching contacts.txt.
+// Folded full names are also kept back to back in a name column, with
+// posting lists of their bigrams, for ranked fuzzy name search.
+// Mutations come from the GUI thread while searches run on a worker, so
+// every public method takes the index lock.
+class SearchIndex
+{
+    public:
+        typedef std::function<bool()> CancelCheck;
+
+        SearchIndex() : liveCount_(0), version_(0)
+        {
+
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ClearLocked();
+        }
+
+        void AddContact(ContactNode* contact)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            RemoveLocked(contact);
+            AddLocked(contact);
+        }
+
+        void UpdateContact(ContactNode* contact)
+        {
+            AddContact(contact);
+        }
+
+        void RemoveContact(ContactNode* contact)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            RemoveLocked(contact);
+        }
+
+        // Finds every contact whose folded record line contains the folded
+        // query, sorted by that line.
+        // When the index is unchanged since the previous result and the query
+        // contains the previous one, only the previous matches are re-checked.
+        // Returns false, leaving the result untouched, if the search was cancelled.
+        bool Search(const std::string& query, SearchResult& result, const CancelCheck& cancelCheck = CancelCheck()) const
+        {
+            CancelCheck cancelled = cancelCheck ? cancelCheck : []() { return false; };
+            std::string pattern = FoldText(query);
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<ContactNode*> contacts;
+
+            bool refine = result.valid && !result.fuzzy && !result.query.empty() && result.version == version_ && query.find(result.query) != std::string::npos;
+            if (refine)
+            {
+                // A subset of a sorted list stays sorted
+                if (!RefineLocked(result.contacts, pattern, contacts, cancelled))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                std::vector<std::uint32_t> matches;
+                if (!SearchLocked(pattern, matches, cancelled))
+                {
+                    return false;
+                }
+                std::sort(matches.begin(), matches.end(), [this](std::uint32_t a, std::uint32_t b)
+                {
+                    return documents_[a].text < documents_[b].text;
+                });
+
+                contacts.reserve(matches.size());
+                for (std::uint32_t docId : matches)
+                {
+                    contacts.push_back(documents_[docId].contact);
+                }
+            }
+
+            result.query = query;
+            result.contacts.swap(contacts);
+            result.version = version_;
+            result.valid = true;
+            result.fuzzy = false;
+            return true;
+        }
+
+        // Finds the contacts whose full name holds the query within a few
+        // edits, ignoring case and accents, closest first. One edit is
+        // allowed per FUZZY_CHARS_PER_EDIT query characters. Bigram counts
+        // rule out most names before the edit distance is computed.
+        // Returns false, leaving the result untouched, if the search was cancelled.
+        bool FuzzySearch(const std::string& query, SearchResult& result, const CancelCheck& cancelCheck = CancelCheck()) const
+        {
+            CancelCheck cancelled = cancelCheck ? cancelCheck : []() { return false; };
+            std::string pattern = FoldText(query);
+            if (pattern.size() > MAX_FUZZY_QUERY)
+            {
+                pattern.resize(MAX_FUZZY_QUERY);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<FuzzyMatch> matches;
+            if (!FuzzySearchLocked(pattern, matches, cancelled))
+            {
+                return false;
+            }
+            std::sort(matches.begin(), matches.end(), [this](const FuzzyMatch& a, const FuzzyMatch& b)
+            {
+                if (a.distance != b.distance)
+                {
+                    return a.distance < b.distance;
+                }
+                return documents_[a.docId].text < documents_[b.docId].text;
+            });
+
+            std::vector<ContactNode*> contacts;
+            contacts.reserve(matches.size());
+            for (const FuzzyMatch& match : matches)
+            {
+                contacts.push_back(documents_[match.docId].contact);
+            }
+
+            result.query = query;
+            result.contacts.swap(contacts);
+            result.version = version_;
+            result.valid = true;
+            result.fuzzy = true;
+            return true;
+        }
+
+        size_t Size() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return liveCount_;
+        }
+
+        // Changes whenever a contact is added, updated or removed
+        std::uint64_t GetVersion() const
+        {
+            return version_;
+        }
+
+    private:
+        struct Document
+        {
+            ContactNode* contact;
+
+            // Folded record line, the shadow copy every substring search reads
+            std::string text;
+            std::uint32_t nameOffset;
+            std::uint32_t nameLength;
+        };
+
+        struct FuzzyMatch
+        {
+            std::uint32_t docId;
+            int distance;
+        };
+
+        // How many documents are scanned between two cancellation checks
+        static const size_t CANCEL_CHECK_INTERVAL = 4096;
+
+        // Query characters per allowed edit in a fuzzy search
+        static const size_t FUZZY_CHARS_PER_EDIT = 4;
+
+        // Fuzzy queries are cut to one machine word of pattern bits
+        static const size_t MAX_FUZZY_QUERY = 64;
+
+        mutable std::mutex mutex_;
+        std::vector<Document> documents_;
+        std::unordered_map<ContactNode*, std::uint32_t> docIds_;
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings_;
+        std::string names_;
+        std::unordered_map<std::uint16_t, std::vector<std::uint32_t>> namePostings_;
+        size_t liveCount_;
+        std::atomic<std::uint64_t> version_;
+
+        void ClearLocked()
+        {
+            documents_.clear();
+            docIds_.clear();
+            postings_.clear();
+            names_.clear();
+            namePostings_.clear();
+            liveCount_ = 0;
+            version_++;
+        }
+
+        void AddLocked(ContactNode* contact)
+        {
+            // Document ids only grow, so appending keeps every posting list sorted
+            std::uint32_t docId = static_cast<std::uint32_t>(documents_.size());
+            std::uint32_t nameOffset = static_cast<std::uint32_t>(names_.size());
+            AppendFolded(names_, contact->getFullName());
+            std::uint32_t nameLength = static_cast<std::uint32_t>(names_.size()) - nameOffset;
+            documents_.push_back(Document{contact, FoldRecord(contact), nameOffset, nameLength});
+            docIds_[contact] = docId;
+            liveCount_++;
+            version_++;
+
+            for (std::uint32_t trigram : GetTrigrams(documents_.back().text))
+            {
+                postings_[trigram].push_back(docId);
+            }
+            for (std::uint16_t bigram : GetBigrams(GetName(documents_.back())))
+            {
+                namePostings_[bigram].push_back(docId);
+            }
+        }
+
+        void RemoveLocked(ContactNode* contact)
+        {
+            auto it = docIds_.find(contact);
+            if (it == docIds_.end())
+            {
+                return;
+            }
+
+            std::uint32_t docId = it->second;
+            Document& document = documents_[docId];
+            for (std::uint32_t trigram : GetTrigrams(document.text))
+            {
+                auto posting = postings_.find(trigram);
+                if (posting == postings_.end())
+                {
+                    continue;
+                }
+
+                std::vector<std::uint32_t>& docs = posting->second;
+                auto pos = std::lower_bound(docs.begin(), docs.end(), docId);
+                if (pos != docs.end() && *pos == docId)
+                {
+                    docs.erase(pos);
+                }
+                if (docs.empty())
+                {
+                    postings_.erase(posting);
+                }
+            }
+
+            for (std::uint16_t bigram : GetBigrams(GetName(document)))
+            {
+                auto posting = namePostings_.find(bigram);
+                if (posting == namePostings_.end())
+                {
+                    continue;
+                }
+
+                std::vector<std::uint32_t>& docs = posting->second;
+                auto pos = std::lower_bound(docs.begin(), docs.end(), docId);
+                if (pos != docs.end() && *pos == docId)
+                {
+                    docs.erase(pos);
+                }
+                if (docs.empty())
+                {
+                    namePostings_.erase(posting);
+                }
+            }
+
+            // The name bytes stay in the column until the next compaction
+            document.contact = nullptr;
+            std::string().swap(document.text);
+            document.nameLength = 0;
+            docIds_.erase(it);
+            liveCount_--;
+            version_++;
+
+            // Renumber once removed documents outnumber the live ones
+            if (documents_.size() > 1024 && documents_.size() > 2 * liveCount_)
+            {
+                CompactLocked();
+            }
+        }
+
+        bool SearchLocked(const std::string& query, std::vector<std::uint32_t>& results, const CancelCheck& cancelled) const
+        {
+            if (query.size() < 3)
+            {
+                // Too short for a trigram, check the in-memory lines directly
+                for (size_t i = 0; i < documents_.size(); i++)
+                {
+                    if (i % CANCEL_CHECK_INTERVAL == 0 && cancelled())
+                    {
+                        return false;
+                    }
+
+                    const Document& document = documents_[i];
+                    if (document.contact && document.text.find(query) != std::string::npos)
+                    {
+                        results.push_back(static_cast<std::uint32_t>(i));
+                    }
+                }
+                return true;
+            }
+
+            // Gather the posting lists of the query, shortest first
+            std::vector<const std::vector<std::uint32_t>*> lists;
+            for (std::uint32_t trigram : GetTrigrams(query))
+            {
+                auto posting = postings_.find(trigram);
+                if (posting == postings_.end())
+                {
+                    return true;
+                }
+                lists.push_back(&posting->second);
+            }
+            std::sort(lists.begin(), lists.end(), [](const std::vector<std::uint32_t>* a, const std::vector<std::uint32_t>* b)
+            {
+                return a->size() < b->size();
+            });
+
+            std::vector<std::uint32_t> candidates(*lists.front());
+            for (size_t i = 1; i < lists.size() && !candidates.empty(); i++)
+            {
+                if (cancelled())
+                {
+                    return false;
+                }
+                candidates = Intersect(candidates, *lists[i]);
+            }
+
+            // Trigrams may match out of order, confirm the full substring
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                if (i % CANCEL_CHECK_INTERVAL == 0 && cancelled())
+                {
+                    return false;
+                }
+
+                if (documents_[candidates[i]].text.find(query) != std::string::npos)
+                {
+                    results.push_back(candidates[i]);
+                }
+            }
+            return true;
+        }
+
+        bool RefineLocked(const std::vector<ContactNode*>& previous, const std::string& query, std::vector<ContactNode*>& results, const CancelCheck& cancelled) const
+        {
+            for (size_t i = 0; i < previous.size(); i++)
+            {
+                if (i % CANCEL_CHECK_INTERVAL == 0 && cancelled())
+                {
+                    return false;
+                }
+
+                auto it = docIds_.find(previous[i]);
+                if (it != docIds_.end() && documents_[it->second].text.find(query) != std::string::npos)
+                {
+                    results.push_back(previous[i]);
+                }
+            }
+            return true;
+        }
+
+        bool FuzzySearchLocked(const std::string& pattern, std::vector<FuzzyMatch>& matches, const CancelCheck& cancelled) const
+        {
+            int maxDistance = static_cast<int>(pattern.size() / FUZZY_CHARS_PER_EDIT);
+
+            // q-gram lemma: a name within k edits of the pattern shares at
+            // least m - q + 1 - k * q of the pattern's q-grams, counted with repeats
+            std::vector<std::uint32_t> candidates;
+            long threshold = static_cast<long>(pattern.size()) - 1 - 2 * maxDistance;
+            if (threshold > 0)
+            {
+                std::vector<std::uint16_t> bigrams;
+                for (size_t i = 0; i + 1 < pattern.size(); i++)
+                {
+                    bigrams.push_back(MakeBigram(pattern[i], pattern[i + 1]));
+                }
+                std::sort(bigrams.begin(), bigrams.end());
+
+                std::vector<std::uint8_t> counts(documents_.size(), 0);
+                for (size_t i = 0; i < bigrams.size();)
+                {
+                    size_t repeats = 1;
+                    while (i + repeats < bigrams.size() && bigrams[i + repeats] == bigrams[i])
+                    {
+                        repeats++;
+                    }
+                    if (cancelled())
+                    {
+                        return false;
+                    }
+
+                    auto posting = namePostings_.find(bigrams[i]);
+                    if (posting != namePostings_.end())
+                    {
+                        for (std::uint32_t docId : posting->second)
+                        {
+                            bool below = counts[docId] < threshold;
+                            counts[docId] = static_cast<std::uint8_t>(counts[docId] + repeats);
+                            if (below && counts[docId] >= threshold)
+                            {
+                                candidates.push_back(docId);
+                            }
+                        }
+                    }
+                    i += repeats;
+                }
+            }
+            else
+            {
+                // Too many edits for the filter to rule anything out
+                for (size_t i = 0; i < documents_.size(); i++)
+                {
+                    if (documents_[i].contact)
+                    {
+                        candidates.push_back(static_cast<std::uint32_t>(i));
+                    }
+                }
+            }
+
+            std::uint64_t peq[256] = {};
+            for (size_t i = 0; i < pattern.size(); i++)
+            {
+                peq[static_cast<unsigned char>(pattern[i])] |= std::uint64_t(1) << i;
+            }
+
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                if (i % CANCEL_CHECK_INTERVAL == 0 && cancelled())
+                {
+                    return false;
+                }
+
+                const Document& document = documents_[candidates[i]];
+                int distance = pattern.empty() ? 0 : SubstringEditDistance(peq, pattern.size(), names_.data() + document.nameOffset, document.nameLength);
+                if (distance <= maxDistance)
+                {
+                    matches.push_back(FuzzyMatch{candidates[i], distance});
+                }
+            }
+            return true;
+        }
+
+        // Smallest edit distance between a pattern of 1 to 64 bytes and any
+        // substring of the text, by Myers' bit-parallel algorithm: one column
+        // of the dynamic programming matrix per text byte, held as bit vectors
+        // of its vertical deltas. peq holds the pattern positions of each byte.
+        static int SubstringEditDistance(const std::uint64_t* peq, size_t patternLength, const char* text, size_t textLength)
+        {
+            std::uint64_t lastBit = std::uint64_t(1) << (patternLength - 1);
+            std::uint64_t positive = ~std::uint64_t(0);
+            std::uint64_t negative = 0;
+            int score = static_cast<int>(patternLength);
+            int best = score;
+            for (size_t j = 0; j < textLength && best > 0; j++)
+            {
+                std::uint64_t equal = peq[static_cast<unsigned char>(text[j])];
+                std::uint64_t verticalChange = equal | negative;
+                std::uint64_t horizontalChange = (((equal & positive) + positive) ^ positive) | equal;
+                std::uint64_t horizontalPositive = negative | ~(horizontalChange | positive);
+                std::uint64_t horizontalNegative = positive & horizontalChange;
+                if (horizontalPositive & lastBit)
+                {
+                    score++;
+                }
+                else if (horizontalNegative & lastBit)
+                {
+                    score--;
+                }
+
+                // A match may start anywhere in the text, so no carry enters the first row
+                horizontalPositive <<= 1;
+                horizontalNegative <<= 1;
+                positive = horizontalNegative | ~(verticalChange | horizontalPositive);
+                negative = horizontalPositive & verticalChange;
+                best = std::min(best, score);
+            }
+            return best;
+        }
+
+        // The record line of a contact with every field folded
+        static std::string FoldRecord(const ContactNode* contact)
+        {
+            std::string text;
+            for (int field = 0; field < FIELD_COUNT; field++)
+            {
+                if (field > 0)
+                {
+                    text += ',';
+                }
+                AppendFolded(text, contact->getField(static_cast<ContactField>(field)));
+            }
+            return text;
+        }
+
+        std::string_view GetName(const Document& document) const
+        {
+            return std::string_view(names_.data() + document.nameOffset, document.nameLength);
+        }
+
+        static std::uint16_t MakeBigram(char first, char second)
+        {
+            return static_cast<std::uint16_t>((static_cast<unsigned char>(first) << 8) | static_cast<unsigned char>(second));
+        }
+
+        // Distinct bigrams of a folded name
+        static std::vector<std::uint16_t> GetBigrams(std::string_view name)
+        {
+            std::vector<std::uint16_t> bigrams;
+            for (size_t i = 0; i + 1 < name.size(); i++)
+            {
+                bigrams.push_back(MakeBigram(name[i], name[i + 1]));
+            }
+            std::sort(bigrams.begin(), bigrams.end());
+            bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+            return bigrams;
+        }
+
+        // Distinct trigrams of a string packed into 24 bits
+        static std::vector<std::uint32_t> GetTrigrams(const std::string& text)
+        {
+            std::vector<std::uint32_t> trigrams;
+            if (text.size() < 3)
+            {
+                return trigrams;
+            }
+
+            trigrams.reserve(text.size() - 2);
+            for (size_t i = 0; i + 2 < text.size(); i++)
+            {
+                std::uint32_t trigram = (static_cast<std::uint32_t>(static_cast<unsigned char>(text[i])) << 16) |
+                                        (static_cast<std::uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8) |
+                                        static_cast<std::uint32_t>(static_cast<unsigned char>(text[i + 2]));
+                trigrams.push_back(trigram);
+            }
+            std::sort(trigrams.begin(), trigrams.end());
+            trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+            return trigrams;
+        }
+
+        // Walks the short list and binary searches the long one
+        static std::vector<std::uint32_t> Intersect(const std::vector<std::uint32_t>& shortList, const std::vector<std::uint32_t>& longList)
+        {
+            std::vector<std::uint32_t> result;
+            auto from = longList.begin();
+            for (std::uint32_t docId : shortList)
+            {
+                from = std::lower_bound(from, longList.end(), docId);
+                if (from == longList.end())
+                {
+                    break;
+                }
+                if (*from == docId)
+                {
+                    result.push_back(docId);
+                }
+            }
+            return result;
+        }
+
+        void CompactLocked()
+        {
+            std::vector<ContactNode*> contacts;
+            contacts.reserve(liveCount_);
+            for (const auto& document : documents_)
+            {
+                if (document.contact)
+                {
+                    contacts.push_back(document.contact);
+                }
+            }
+
+            ClearLocked();
+            for (ContactNode* contact : contacts)
+            {
+                AddLocked(contact);
+            }
+        }
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,116 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "searchindex.h"
+
+// Matches posted back to the GUI thread as the payload of a wxEVT_THREAD event
+struct SearchReply
+{
+    std::uint64_t generation;
+    SearchResult result;
+};
+
+// Runs the queries of a SearchWindow off the GUI thread.
+// Only the latest submitted query matters: submitting a new one, or
+// cancelling, stops the query in flight, and its results are never posted.
+class SearchWorker : public wxThread
+{
+    public:
+        SearchWorker(wxEvtHandler* sink, const SearchIndex* searchIndex) : wxThread(wxTHREAD_JOINABLE), sink_(sink), searchIndex_(searchIndex), condition_(mutex_), pendingGeneration_(0), pendingFuzzy_(false), hasPending_(false), latestGeneration_(0), stopping_(false)
+        {
+
+        }
+
+        // A fuzzy query ranks names by edit distance instead of matching substrings
+        void Submit(const std::string& query, std::uint64_t generation, bool fuzzy)
+        {
+            wxMutexLocker lock(mutex_);
+            pendingQuery_ = query;
+            pendingGeneration_ = generation;
+            pendingFuzzy_ = fuzzy;
+            hasPending_ = true;
+            latestGeneration_ = generation;
+            condition_.Signal();
+        }
+
+        // Drops the query in flight and any not started yet, without
+        // submitting another; generation is the caller's newest
+        void Cancel(std::uint64_t generation)
+        {
+            wxMutexLocker lock(mutex_);
+            hasPending_ = false;
+            latestGeneration_ = generation;
+        }
+
+        // Asks the thread to finish; the caller still has to Wait() for it
+        void Stop()
+        {
+            wxMutexLocker lock(mutex_);
+            stopping_ = true;
+            condition_.Signal();
+        }
+
+    protected:
+        ExitCode Entry() override
+        {
+            // The previous result lives on this thread so growing queries can refine it
+            SearchResult result;
+
+            while (true)
+            {
+                std::string query;
+                std::uint64_t generation;
+                bool fuzzy;
+                {
+                    wxMutexLocker lock(mutex_);
+                    while (!hasPending_ && !stopping_)
+                    {
+                        condition_.Wait();
+                    }
+                    if (stopping_)
+                    {
+                        break;
+                    }
+                    query = pendingQuery_;
+                    generation = pendingGeneration_;
+                    fuzzy = pendingFuzzy_;
+                    hasPending_ = false;
+                }
+
+                auto cancelled = [this, generation]()
+                {
+                    return stopping_ || latestGeneration_ != generation;
+                };
+                bool completed = fuzzy ? searchIndex_->FuzzySearch(query, result, cancelled) : searchIndex_->Search(query, result, cancelled);
+                if (!completed || cancelled())
+                {
+                    continue;
+                }
+
+                wxThreadEvent* event = new wxThreadEvent();
+                event->SetPayload(SearchReply{generation, result});
+                wxQueueEvent(sink_, event);
+            }
+
+            return static_cast<ExitCode>(0);
+        }
+
+    private:
+        wxEvtHandler* sink_;
+        const SearchIndex* searchIndex_;
+        wxMutex mutex_;
+        wxCondition condition_;
+        std::string pendingQuery_;
+        std::uint64_t pendingGeneration_;
+        bool pendingFuzzy_;
+        bool hasPending_;
+        std::atomic<std::uint64_t> latestGeneration_;
+        std::atomic<bool> stopping_;
+};
+
+#endif // SEARCHWORKER_H
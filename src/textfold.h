@@ -0,0 +1,52 @@
+#ifndef TEXTFOLD_H
+#define TEXTFOLD_H
+
+#include <string>
+#include <string_view>
+
+// Writes text lower cased and with the accents of Latin-1 letters removed,
+// so "González" and "GONZALEZ" fold to the same bytes. Other UTF-8 is kept.
+// out needs room for text.size() bytes; returns the number of bytes written.
+inline size_t FoldTextTo(char* out, std::string_view text)
+{
+    // Base letter of U+00C0 to U+00FF, written in UTF-8 as 0xC3 0x80 to 0xC3 0xBF; 0 keeps the character
+    static const char LATIN1_BASE[65] = "aaaaaaaceeeeiiiidnooooo\0ouuuuy\0saaaaaaaceeeeiiiidnooooo\0ouuuuy\0y";
+
+    char* start = out;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        char c = text[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            *out++ = static_cast<char>(c - 'A' + 'a');
+        }
+        else if (static_cast<unsigned char>(c) == 0xC3 && i + 1 < text.size() && (static_cast<unsigned char>(text[i + 1]) & 0xC0) == 0x80 && LATIN1_BASE[static_cast<unsigned char>(text[i + 1]) - 0x80] != '\0')
+        {
+            *out++ = LATIN1_BASE[static_cast<unsigned char>(text[i + 1]) - 0x80];
+            i++;
+        }
+        else
+        {
+            *out++ = c;
+        }
+    }
+    return out - start;
+}
+
+// Appends text folded as FoldTextTo() writes it
+inline void AppendFolded(std::string& folded, std::string_view text)
+{
+    size_t length = folded.size();
+    folded.resize(length + text.size());
+    folded.resize(length + FoldTextTo(&folded[length], text));
+}
+
+inline std::string FoldText(std::string_view text)
+{
+    std::string folded;
+    folded.reserve(text.size());
+    AppendFolded(folded, text);
+    return folded;
+}
+
+#endif // TEXTFOLD_H